@@ -0,0 +1,121 @@
+#include "AllocTracker.h"
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+bool allocTracking = false;
+
+static thread_local AllocCounts threadCounts = { 0, 0 };
+
+AllocCounts allocCounts() {
+	return threadCounts;
+}
+
+static void* allocate(size_t size) {
+	if (allocTracking) {
+		threadCounts.allocs++;
+		threadCounts.bytes += size;
+	}
+	return malloc(size ? size : 1);
+}
+
+void* operator new(size_t size) {
+	void* p = allocate(size);
+	if (!p) throw bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size) {
+	void* p = allocate(size);
+	if (!p) throw bad_alloc();
+	return p;
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+	return allocate(size);
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept {
+	return allocate(size);
+}
+
+// Aligned forms, which pmr::new_delete_resource uses
+static void* allocateAligned(size_t size, size_t alignment) {
+	if (allocTracking) {
+		threadCounts.allocs++;
+		threadCounts.bytes += size;
+	}
+	void* p = NULL;
+	if (alignment < sizeof(void*)) alignment = sizeof(void*);
+	if (posix_memalign(&p, alignment, size ? size : 1) != 0) return NULL;
+	return p;
+}
+
+void* operator new(size_t size, align_val_t alignment) {
+	void* p = allocateAligned(size, (size_t)alignment);
+	if (!p) throw bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size, align_val_t alignment) {
+	void* p = allocateAligned(size, (size_t)alignment);
+	if (!p) throw bad_alloc();
+	return p;
+}
+
+void* operator new(size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+	return allocateAligned(size, (size_t)alignment);
+}
+
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+	return allocateAligned(size, (size_t)alignment);
+}
+
+void operator delete(void* p, align_val_t) noexcept {
+	free(p);
+}
+
+void operator delete[](void* p, align_val_t) noexcept {
+	free(p);
+}
+
+void operator delete(void* p, size_t, align_val_t) noexcept {
+	free(p);
+}
+
+void operator delete[](void* p, size_t, align_val_t) noexcept {
+	free(p);
+}
+
+void operator delete(void* p, align_val_t, const nothrow_t&) noexcept {
+	free(p);
+}
+
+void operator delete[](void* p, align_val_t, const nothrow_t&) noexcept {
+	free(p);
+}
+
+void operator delete(void* p) noexcept {
+	free(p);
+}
+
+void operator delete[](void* p) noexcept {
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+	free(p);
+}
+
+void operator delete(void* p, const nothrow_t&) noexcept {
+	free(p);
+}
+
+void operator delete[](void* p, const nothrow_t&) noexcept {
+	free(p);
+}
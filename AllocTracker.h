@@ -0,0 +1,35 @@
+#ifndef ALLOCTRACKER_H
+#define ALLOCTRACKER_H
+
+#include <cstdint>
+#include <sys/resource.h>
+
+using namespace std;
+
+/*
+ * Heap allocation accounting. AllocTracker.cpp replaces the global
+ * operator new, and while allocTracking is set every allocation is counted
+ * against the thread that made it. Take allocCounts() before and after a
+ * piece of work to see what it allocated; PhaseTimer (Stats.h) does this for
+ * every phase when tracking is on.
+ */
+
+struct AllocCounts {
+	uint64_t allocs;
+	uint64_t bytes;
+};
+
+// Count allocations from now on; off by default, costing one branch per new
+extern bool allocTracking;
+
+// Allocations this thread has made while tracking was on
+AllocCounts allocCounts();
+
+// Largest resident set the process has had, in KB
+inline long peakRSSKB() {
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+	return usage.ru_maxrss;
+}
+
+#endif
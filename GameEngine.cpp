@@ -0,0 +1,1320 @@
+/*
+-----------------------------
+Puzzle Game utilizing JGraph
+by Tyler Cultice
+-----------------------------
+
+Tiles, the board, the rules of the game and drawing a board. See GameEngine.h.
+*/
+
+#include "GameEngine.h"
+#include "Stats.h"
+#include "PerfCounters.h"
+#include <algorithm>
+#include <fstream>
+
+Board::Board(const Board& other) {
+	*this = other;
+}
+
+Board::Board(Board&& other) {
+	*this = move(other);
+}
+
+Board& Board::operator=(const Board& other) {
+	len = other.len;
+	height = other.height;
+	bits = other.bits;
+	chunksHigh = other.chunksHigh;
+	tiles = other.tiles;
+	flags = other.flags;
+	unsavedList = other.unsavedList;
+	saved = other.saved;
+	markAllDirty();
+	return *this;
+}
+
+Board& Board::operator=(Board&& other) {
+	len = other.len;
+	height = other.height;
+	bits = other.bits;
+	chunksHigh = other.chunksHigh;
+	tiles = move(other.tiles);
+	flags = move(other.flags);
+	dirtyList = move(other.dirtyList);
+	unsavedList = move(other.unsavedList);
+	saved = move(other.saved);
+	markAllDirty();
+	return *this;
+}
+
+// Set the size with every tile blocked and nothing marked
+void Board::shape(int newLen, int newHeight) {
+	len = newLen;
+	height = newHeight;
+	bits = chunkBitsFor(newLen, newHeight);
+	chunksHigh = (newHeight + (1 << bits) - 1) >> bits;
+	int chunksLong = (newLen + (1 << bits) - 1) >> bits;
+	tiles.assign((size_t)chunksLong * chunksHigh << (2 * bits), Tile(Tile::TileType::BLOCKED, 0));
+	flags.assign(chunksLong * chunksHigh, 0);
+	dirtyList.clear();
+	unsavedList.clear();
+	saved = BoardSnapshot();
+}
+
+void Board::resize(int newLen, int newHeight, minstd_rand& rng) {
+	// Spare tiles past the edge are blocked, so they don't use the generator
+	Board resized;
+	resized.shape(newLen, newHeight);
+	for (int x = 0; x < newLen; x++) {
+		for (int y = 0; y < newHeight; y++) {
+			if (x < len && y < height) resized[x][y] = (*this)[x][y];
+			else resized[x][y].initTile(rng);
+		}
+	}
+	*this = move(resized);
+}
+
+void Board::markAllDirty() {
+	dirtyList.resize(flags.size());
+	for (int i = 0; i < flags.size(); i++) {
+		flags[i] |= CHUNK_DIRTY;
+		dirtyList[i] = i;
+	}
+}
+
+void Board::clearDirty() {
+	for (int i = 0; i < dirtyList.size(); i++) {
+		flags[dirtyList[i]] &= ~CHUNK_DIRTY;
+	}
+	dirtyList.clear();
+}
+
+// FNV-1a of the size and every tile, column by column
+uint64_t Board::hash() const {
+	uint64_t value = 14695981039346656037ULL;
+	auto mix = [&](uint64_t byte) {
+		value = (value ^ byte) * 1099511628211ULL;
+	};
+	mix(len & 0xff);
+	mix(len >> 8);
+	mix(height & 0xff);
+	mix(height >> 8);
+	for (int x = 0; x < len; x++) {
+		Column<const Tile> column = (*this)[x];
+		for (int y = 0; y < height; y++) {
+			mix(((int)column[y].type << 2) | column[y].size);
+		}
+	}
+	return value;
+}
+
+BoardSnapshot Board::snapshot() {
+	// Nothing changed, the last snapshot still holds
+	bool shared = saved.chunks && saved.len == len && saved.height == height;
+	if (shared && unsavedList.empty()) return saved;
+
+	shared_ptr<BoardSnapshot::ChunkTable> chunks(shared ? new BoardSnapshot::ChunkTable(*saved.chunks)
+		: new BoardSnapshot::ChunkTable(flags.size()));
+	for (int chunk = 0; chunk < flags.size(); chunk++) {
+		if (shared && !(flags[chunk] & CHUNK_UNSAVED)) continue;
+		Tile* first = &tiles[(size_t)chunk * chunkTiles()];
+		(*chunks)[chunk] = make_shared<const vector<Tile> >(first, first + chunkTiles());
+		flags[chunk] &= ~CHUNK_UNSAVED;
+	}
+	unsavedList.clear();
+
+	saved.len = len;
+	saved.height = height;
+	saved.chunks = chunks;
+	return saved;
+}
+
+// Copy one chunk of a snapshot the same size as the board over the board
+void Board::copyChunk(const BoardSnapshot& snapshot, int chunk) {
+	const vector<Tile>& from = *(*snapshot.chunks)[chunk];
+	copy(from.begin(), from.end(), tiles.begin() + (size_t)chunk * chunkTiles());
+	markChunk(chunk);
+	flags[chunk] &= ~CHUNK_UNSAVED;
+}
+
+void Board::restore(const BoardSnapshot& snapshot) {
+	if (!snapshot.chunks) return;
+
+	// A different size starts over; otherwise only what changed since the
+	// last snapshot, and what differs between it and this one, is copied
+	if (!saved.chunks || snapshot.len != len || snapshot.height != height) {
+		shape(snapshot.len, snapshot.height);
+		for (int chunk = 0; chunk < flags.size(); chunk++) {
+			copyChunk(snapshot, chunk);
+		}
+	}
+	else if (snapshot.chunks == saved.chunks) {
+		for (int i = 0; i < unsavedList.size(); i++) {
+			copyChunk(snapshot, unsavedList[i]);
+		}
+	}
+	else {
+		for (int chunk = 0; chunk < flags.size(); chunk++) {
+			if ((flags[chunk] & CHUNK_UNSAVED) || (*snapshot.chunks)[chunk] != (*saved.chunks)[chunk]) {
+				copyChunk(snapshot, chunk);
+			}
+		}
+	}
+	unsavedList.clear();
+	saved = snapshot;
+}
+
+// Call add(curve, point) for every tile of one chunk that gets drawn
+template <class F>
+void chunkPoints(const Board& tiles, int chunk, F add) {
+	float height = tiles[0].size();
+	int left = tiles.chunkX(chunk);
+	int top = tiles.chunkY(chunk);
+	int right = min(left + tiles.chunkSide(), tiles.size());
+	int bottom = min(top + tiles.chunkSide(), tiles[0].size());
+	for (int i = left; i < right; i++) {
+		for (int j = top; j < bottom; j++) {
+			const Tile& tile = tiles[i][j];
+			if (tile.type == Tile::TileType::BLOCKED || tile.type == Tile::TileType::empty) continue;
+			add(3 * (int)tile.type + tile.size, JGraph::Point<float>{ i + 0.5F, (height-1 - j) + 0.5F });
+		}
+	}
+}
+
+void BoardPoints::update(Board& tiles) {
+	// An empty board has no column to take the height of, and nothing to draw
+	if (tiles.size() == 0) {
+		len = height = 0;
+		points.clear();
+		tiles.clearDirty();
+		return;
+	}
+	if (tiles.size() != len || tiles[0].size() != height || points.size() != (size_t)tiles.chunkCount() * TILE_CURVES) {
+		len = tiles.size();
+		height = tiles[0].size();
+		points.assign((size_t)tiles.chunkCount() * TILE_CURVES, vector<JGraph::Point<float>>());
+		tiles.markAllDirty();
+	}
+
+	const vector<int>& dirty = tiles.dirtyChunks();
+	for (int i = 0; i < dirty.size(); i++) {
+		vector<JGraph::Point<float>>* chunk = &points[(size_t)dirty[i] * TILE_CURVES];
+		for (int curve = 0; curve < TILE_CURVES; curve++) {
+			chunk[curve].clear();
+		}
+		chunkPoints(tiles, dirty[i], [&](int curve, JGraph::Point<float> point) {
+			chunk[curve].push_back(point);
+		});
+	}
+	tiles.clearDirty();
+}
+
+void BoardPoints::addTo(JGraph::Graph& graph) const {
+	size_t chunks = points.size() / TILE_CURVES;
+	for (int curve = 0; curve < TILE_CURVES; curve++) {
+		size_t total = 0;
+		for (size_t chunk = 0; chunk < chunks; chunk++) {
+			total += points[chunk * TILE_CURVES + curve].size();
+		}
+		JGraph::Curve& out = graph.curves[curve];
+		out.points.reserve(out.points.size() + total);
+		for (size_t chunk = 0; chunk < chunks; chunk++) {
+			const vector<JGraph::Point<float>>& in = points[chunk * TILE_CURVES + curve];
+			out.points.insert(out.points.end(), in.begin(), in.end());
+		}
+	}
+}
+
+// Read a board size written as WxH, false if it isn't one or is out of limits
+bool parseBoardSize(string text, int& len, int& height) {
+	size_t x = text.find('x');
+	if (x == string::npos || x == 0 || x + 1 == text.size() || x > 4 || text.size() - x - 1 > 4) return false;
+	if (!all_of(text.begin(), text.begin() + x, ::isdigit) || !all_of(text.begin() + x + 1, text.end(), ::isdigit)) return false;
+	len = stoi(text.substr(0, x));
+	height = stoi(text.substr(x + 1));
+	return len >= BOARD_MIN && len <= BOARD_MAX && height >= BOARD_MIN && height <= BOARD_MAX;
+}
+
+GameEngine::GameEngine() : rng(random_device{}()) {
+	gameScore = 0;
+	turnsLeft = 0;
+	ruleSet = RuleSet::classic;
+	groupsStale = true;
+}
+
+// Seed the tile generator, so that a recorded game can be replayed exactly
+void GameEngine::seed(unsigned long value) {
+	rng.seed(value);
+}
+
+// Start a new len x height game with 10 turns
+void GameEngine::newGame(int len, int height) {
+	withRules(ruleSet, [&](auto rules) { newGameWith<decltype(rules)>(len, height); });
+}
+
+template <class Rules>
+void GameEngine::newGameWith(int len, int height) {
+	// Every tile is dealt again, not just the ones past the last game's board
+	tiles = Board();
+	tiles.resize(len, height, rng);
+
+	// Block the tiles the rules block (the corners, classically), and keep
+	// the rest small enough to pop
+	for (int x = 0; x < len; x++) {
+		for (int y = 0; y < height; y++) {
+			Tile& tile = tiles[x][y];
+			if (Rules::blocked(x, y, len, height)) {
+				tile.type = Tile::TileType::BLOCKED;
+				tile.size = 0;
+			}
+			else if (tile.size >= Rules::popSize) {
+				tile.size = Rules::popSize - 1;
+			}
+		}
+	}
+
+	gameScore = 0;
+	turnsLeft = Rules::turns;
+	groupsStale = true;
+}
+
+// Save the game to fileName
+int GameEngine::save(string fileName) const {
+	// 2 Statuses:
+	// 0 Saved successfully
+	// 1 Unable to save
+	ofstream saveFile(fileName, ios::trunc);
+	if (!saveFile.is_open())
+		return 1;
+
+	// Top game identifier
+	saveFile << "-JGRAPHFALL2021CULTICE SCORE-" << endl;
+
+	// Score
+	saveFile << "#" << gameScore << endl;
+
+	// Turns
+	saveFile << "#" << turnsLeft << endl;
+
+	// Size, only if it isn't the default so older versions can read the save
+	if (len() != BOARD_LEN || height() != BOARD_HEIGHT) {
+		saveFile << "#" << len() << "x" << height() << endl;
+	}
+
+	// Rules, likewise only if they aren't the classic ones
+	if (ruleSet != RuleSet::classic) {
+		saveFile << "#rules " << ruleSetName(ruleSet) << endl;
+	}
+	
+	// Load board
+	// 0-2 = Red, size 1 to 3
+	// 3-5 = Green, size 1 to 3
+	// 6-8 = Blue, size 1 to 3
+	// 9-B = Purple, size 1 to 3
+	// C-E = Yellow, size 1 to 3
+	// F = BLOCKED TILE
+	for (int i = 0; i < len(); i++) {
+		for (int j = 0; j < height(); j++) {
+			saveFile << hex << 3 * (int)tiles[i][j].type + tiles[i][j].size;
+		}
+		saveFile << endl;
+	}
+
+	saveFile.close();
+
+	return 0;
+}
+
+// Save file format:
+// Score
+// Num Turns
+// Board size as #WxH, if it isn't 9x6
+// Rule set as #rules name, if it isn't classic
+// Board in decimal form
+
+// Load a save, leaving the game as it was unless it loads
+int GameEngine::load(string fileName) {
+	// 3 Statuses:
+	// 0 Reads successfully
+	// 1 Unable to open it, will try to save later
+	// 2 Format of file is not correct (Actual error)
+	ifstream saveFile(fileName);
+	if (!saveFile.is_open())
+		return 1;
+
+	string tempString;
+	const string TopIdent = "-JGRAPHFALL2021CULTICE SCORE-";
+
+	// Top game identifier
+	getline(saveFile, tempString);
+
+	if (tempString.compare(TopIdent) != 0) return 2;
+
+	// Load Score
+	getline(saveFile, tempString);
+	if (tempString[0] != '#') return 2;
+	tempString = tempString.erase(0, 1);
+
+	if (tempString.empty() || !(find_if(tempString.begin(), tempString.end(),
+		[](char ch) { return !std::isdigit(ch); }) == tempString.end())) return 2;
+
+	long loadedScore = stoi(tempString);
+
+	// Load Turns
+	getline(saveFile, tempString);
+	if (tempString[0] != '#') return 2;
+	tempString = tempString.erase(0, 1);
+
+	if (tempString.empty() || !(find_if(tempString.begin(), tempString.end(),
+		[](char ch) { return !std::isdigit(ch); }) == tempString.end())) return 2;
+
+	int loadedTurns = stoi(tempString);
+
+	// Load size, saves without one are the default size
+	getline(saveFile, tempString);
+	int loadedLen = BOARD_LEN;
+	int loadedHeight = BOARD_HEIGHT;
+	if (!tempString.empty() && tempString[0] == '#' && tempString.compare(0, 7, "#rules ") != 0) {
+		if (!parseBoardSize(tempString.substr(1), loadedLen, loadedHeight)) return 2;
+		getline(saveFile, tempString);
+	}
+
+	// Load rules, saves without them are classic
+	RuleSet loadedRules = RuleSet::classic;
+	if (tempString.compare(0, 7, "#rules ") == 0) {
+		if (!parseRuleSet(tempString.substr(7), loadedRules)) return 2;
+		getline(saveFile, tempString);
+	}
+	int maxTurns = withRules(loadedRules, [](auto rules) { return decltype(rules)::turns; });
+	if (loadedTurns > maxTurns || loadedTurns <= 0) return 2;
+	int popSize = withRules(loadedRules, [](auto rules) { return decltype(rules)::popSize; });
+
+	// Load board
+	// 0-2 = Red, size 1 to 3
+	// 3-5 = Green, size 1 to 3
+	// 6-8 = Blue, size 1 to 3
+	// 9-B = Purple, size 1 to 3
+	// C-E = Yellow, size 1 to 3
+	// F = BLOCKED TILE
+	// The tiles are dealt before being overwritten, so a seeded game
+	// carries on from a save with the same tiles it always has
+	minstd_rand loadedRng = rng;
+	Board loaded;
+	loaded.resize(loadedLen, loadedHeight, loadedRng);
+
+	// Convert board using above mapping, the first row is already read
+	for (int i = 0; i < loadedLen; i++) {
+		if (!saveFile) return 2;
+		if (i > 0) getline(saveFile, tempString);
+		if (tempString.length() != loadedHeight) return 2;
+		for (int j = 0; j < loadedHeight; j++) {
+			char mapValue;
+			// Change to decimal value for easy conversion
+			if (tempString[j] <= '9' && tempString[j] >= '0') mapValue = tempString[j] - '0';
+			else if (tempString[j] >= 'a' && tempString[j] <= 'f') mapValue = tempString[j] - 'a' + 10;
+			else return 2;
+			// divide by 3 gives type, modulo 3 gives size
+			loaded[i][j].type = (Tile::TileType)(mapValue / 3);
+			loaded[i][j].size = (mapValue % 3);
+			// A tile as big as the rules pop at would have popped already
+			if (loaded[i][j].type != Tile::TileType::BLOCKED && loaded[i][j].size >= popSize) return 2;
+		}
+	}
+
+	saveFile.close();
+	tiles = move(loaded);
+	groupsStale = true;
+	rng = loadedRng;
+	gameScore = loadedScore;
+	turnsLeft = loadedTurns;
+	ruleSet = loadedRules;
+	return 0;
+}
+
+// Number of the first tile of moves that is there already (counting from 1), 0 if none is
+static int repeatedTile(const vector<JGraph::Point<int>>& moves) {
+	// Short moves are checked pairwise, long ones sorted
+	if (moves.size() <= 64) {
+		for (int i = 1; i < moves.size(); i++) {
+			for (int j = 0; j < i; j++) {
+				if (moves[i].x == moves[j].x && moves[i].y == moves[j].y) return i + 1;
+			}
+		}
+		return 0;
+	}
+	vector<pair<long, int> > tiles(moves.size());
+	for (int i = 0; i < moves.size(); i++) {
+		tiles[i] = { ((long)moves[i].x << 32) | moves[i].y, i };
+	}
+	sort(tiles.begin(), tiles.end());
+	int first = 0;
+	for (int i = 1; i < tiles.size(); i++) {
+		if (tiles[i].first == tiles[i - 1].first && (first == 0 || tiles[i].second + 1 < first)) first = tiles[i].second + 1;
+	}
+	return first;
+}
+
+// Parse a move in the format {(x0,y0),(x1,y1),(x2,y2)....} and check it against the board
+int GameEngine::validateMove(string text, vector<JGraph::Point<int>>& moves, int& badMove) const {
+	// 5 Statuses:
+	// 0 Move is valid
+	// 1 Format of move is incorrect
+	// 2 Tile number badMove is not adjacent to the last, or is in the move already
+	// 3 Tile number badMove is not the same type as the first
+	// 4 Less than 3 tiles in the move
+	PerfScope counters(PerfKernel::moveParse);
+	moves.clear();
+	badMove = 0;
+
+	// Remove any white space within the input
+	text.erase(remove_if(text.begin(), text.end(),
+		::isspace), text.end());
+
+	// Process the move into proper format: {(x,y),(x,y),...}, coordinates may
+	// have more than one digit on larger boards
+	if (text.length() < 7 || text[0] != '{' || text[text.length()-1] != '}') {
+		return 1;
+	}
+
+	// Read a coordinate at pos, -1 if there isn't one or it is too long
+	size_t pos = 1;
+	auto readNumber = [&]() {
+		int value = 0;
+		size_t digits = 0;
+		while (pos < text.length() && isdigit(text[pos]) && digits < 4) {
+			value = value * 10 + (text[pos] - '0');
+			pos++;
+			digits++;
+		}
+		return (digits == 0 || (pos < text.length() && isdigit(text[pos]))) ? -1 : value;
+	};
+
+	Tile::TileType moveType;
+	for (int i = 0; pos < text.length() - 1; i++) {
+		// Points after the first are separated by commas
+		if (i > 0 && text[pos++] != ',') {
+			return 1;
+		}
+
+		// Parenthesis and comma check
+		if (text[pos++] != '(') {
+			return 1;
+		}
+		int x = readNumber();
+		if (x < 0 || text[pos++] != ',') {
+			return 1;
+		}
+		int y = readNumber();
+		if (y < 0 || text[pos++] != ')') {
+			return 1;
+		}
+
+		// Valid coordinates check
+		if (!(x >= 0 && x < len() && y >= 0 && y < height())) {
+			return 1;
+		}
+
+		moves.push_back({ x,y });
+
+		// The first tile sets the type of the move
+		if (i == 0) {
+			moveType = tiles[x][y].type;
+			if (moveType == Tile::TileType::BLOCKED) {
+				return 1;
+			}
+			continue;
+		}
+
+		// Ensure distance to last one is sufficient
+		if ((abs(moves[i].x - moves[i-1].x) > 1 || abs(moves[i].y -  moves[i-1].y) > 1)) {
+			badMove = i + 1;
+			return 2;
+		}
+
+		// Check color
+		if (tiles[moves[i].x][moves[i].y].type != moveType) {
+			badMove = i + 1;
+			return 3;
+		}
+	}
+	if (pos != text.length() - 1) {
+		return 1;
+	}
+
+	// Every tile counts towards the score of each tile, so a tile used twice
+	// would make a move worth as much as it is long
+	int repeated = repeatedTile(moves);
+	if (repeated > 0) {
+		badMove = repeated;
+		return 2;
+	}
+
+	// Moves check
+	if (moves.size() < GROUP_MIN_TILES) {
+		return 4;
+	}
+
+	return 0;
+}
+
+// Drop the tiles of every column whose entry isn't -1 down, and refill the top
+void GameEngine::tileFall(const vector<int>& columnsToConsider) {
+	PhaseTimer timer(Phase::tileFall);
+	PerfScope counters(PerfKernel::tileFall);
+	for (int i = 0; i < columnsToConsider.size(); i++) {
+		// Ignore if column is untouched
+		if (columnsToConsider[i] == -1) continue;
+		columnFall(i, columnsToConsider[i]);
+	}
+}
+
+// Drop the tiles of column i down into the empty spaces at or above row lowest, and refill the top
+void GameEngine::columnFall(int i, int lowest) {
+	// Everything from the lowest point up may move
+	tiles.markDirty(i, 0, lowest);
+	if (!groupsStale && fallenRows[i] < lowest) {
+		if (fallenRows[i] == -1) fallenColumns.push_back(i);
+		fallenRows[i] = lowest;
+	}
+	auto column = tiles[i];
+
+	// Start at the lowest point
+	int numEmpty = 0;
+	for (int j = lowest; j >= 0; j--) {
+		if (column[j].type == Tile::TileType::BLOCKED) {
+			numEmpty++;
+			continue;
+		}	
+
+		else if (column[j].type == Tile::TileType::empty) {
+			numEmpty++;
+		}
+		// Special case: blocked spaces, ignore spot
+		else if (column[j+numEmpty].type == Tile::TileType::BLOCKED) {
+			numEmpty--;
+			column[j + numEmpty] = column[j];
+		}
+		// Move down next by number of empty
+		else {
+			column[j + numEmpty] = column[j];
+		}
+	}
+	// Now we know the top numEmpty's should be empty, fill them with reset
+	for (int j = 0; j < numEmpty; j++) {
+		if (column[j].type != Tile::TileType::BLOCKED)
+			column[j].resetTile(rng);
+	}
+}
+
+// Neighbors of a cell that are on the board, as bits
+#define NEIGHBOR_LEFT 1
+#define NEIGHBOR_RIGHT 2
+#define NEIGHBOR_BELOW 4
+#define NEIGHBOR_ABOVE 8
+#define NEIGHBOR_LEFT_BELOW 16
+#define NEIGHBOR_RIGHT_BELOW 32
+#define NEIGHBOR_LEFT_ABOVE 64
+#define NEIGHBOR_RIGHT_ABOVE 128
+
+constexpr int neighborsOf(int x, int y, int len, int height) {
+	int sides = (x > 0 ? NEIGHBOR_LEFT : 0) | (x < len - 1 ? NEIGHBOR_RIGHT : 0)
+		| (y < height - 1 ? NEIGHBOR_BELOW : 0) | (y > 0 ? NEIGHBOR_ABOVE : 0);
+	bool left = sides & NEIGHBOR_LEFT;
+	bool right = sides & NEIGHBOR_RIGHT;
+	bool below = sides & NEIGHBOR_BELOW;
+	bool above = sides & NEIGHBOR_ABOVE;
+	return sides | (left && below ? NEIGHBOR_LEFT_BELOW : 0) | (right && below ? NEIGHBOR_RIGHT_BELOW : 0)
+		| (left && above ? NEIGHBOR_LEFT_ABOVE : 0) | (right && above ? NEIGHBOR_RIGHT_ABOVE : 0);
+}
+
+// Neighbors of every cell of a LEN x HEIGHT board, worked out at compile time
+template <int LEN, int HEIGHT>
+struct NeighborTable {
+	constexpr NeighborTable() : cells() {
+		for (int x = 0; x < LEN; x++) {
+			for (int y = 0; y < HEIGHT; y++) {
+				cells[x * HEIGHT + y] = neighborsOf(x, y, LEN, HEIGHT);
+			}
+		}
+	}
+	unsigned char cells[LEN * HEIGHT];
+};
+
+template <int LEN, int HEIGHT>
+constexpr NeighborTable<LEN, HEIGHT> neighborTable;
+
+// Grow the tiles around each popped tile that the rules grow, popping the
+// ones that reach the rules' pop size, until a wave pops nothing. Returns how many tiles popped and sets waves,
+// and adds each column it pops in for the first time to touchedColumns. LEN
+// and HEIGHT are the board size for the sizes specialized at compile time
+// (bounds checks come from a constant table, and the board is a single chunk
+// at a known offset), or 0 for any other size.
+template <class Rules, int LEN, int HEIGHT>
+int GameEngine::popCascade(int& waves) {
+	const int len = LEN ? LEN : this->len();
+	const int height = HEIGHT ? HEIGHT : this->height();
+	constexpr bool specialized = LEN > 0 && HEIGHT > 0;
+	static_assert(!specialized || (LEN <= (1 << Board::CHUNK_BITS) && HEIGHT <= (1 << Board::CHUNK_BITS)),
+		"specialized boards are one chunk");
+	int popped = 0;
+
+	// A neighbour in the same chunk is a fixed distance away in memory, only
+	// ones across a chunk edge need their place worked out. Boards up to
+	// 64x64 are a single chunk, marked once rather than for every tile.
+	const bool oneChunk = specialized || tiles.chunkCount() == 1;
+	const Board::Layout layout = tiles.layout();
+	const int bits = specialized ? Board::chunkBitsFor(LEN, HEIGHT) : layout.bits;
+	const int mask = (1 << bits) - 1;
+	Tile* cells = tiles.data();
+	if (oneChunk) tiles.markDirty(0, 0);
+
+	// Grow a neighbor if it holds a tile, and queue it once it is about to
+	// pop. A tile that is already queued doesn't grow any further.
+	auto grow = [&](int x, int y, int index) {
+		Tile& tile = cells[index];
+		if (tile.type != Tile::TileType::BLOCKED && tile.type != Tile::TileType::empty && tile.size < Rules::popSize) {
+			tile.size++;
+			if (tile.size == Rules::popSize) {
+				popQueue.push({ x, y });
+			}
+		}
+	};
+	// Place of a neighbour across a chunk edge, which changes that chunk too
+	auto across = [&](int x, int y) {
+		if (!oneChunk) tiles.markChunk(layout.chunkOf(x, y));
+		return layout.indexOf(x, y);
+	};
+
+	int wave = 0;
+	for (; !popQueue.empty(); wave++) {
+		TraceScope waveScope("cascade wave", wave);
+		for (size_t waveSize = popQueue.size(); waveSize > 0; waveSize--) {
+			JGraph::Point<int> tileToPop = popQueue.front();
+			popQueue.pop();
+			int x = tileToPop.x;
+			int y = tileToPop.y;
+			int index = specialized ? (x << bits) | y : layout.indexOf(x, y);
+
+			// Pop it, change its type, add to multiplier and score
+			cells[index].type = Tile::TileType::empty;
+			if (!oneChunk) tiles.markChunk(layout.chunkOf(x, y));
+			if (lowestinColumn[x] == -1) {
+				touchedColumns.push_back(x);
+			}
+			if (lowestinColumn[x] < y) {
+				lowestinColumn[x] = y;
+			}
+
+			popped++;
+
+			int neighbors;
+			if constexpr (LEN > 0 && HEIGHT > 0) {
+				neighbors = neighborTable<LEN, HEIGHT>.cells[x * HEIGHT + y];
+			}
+			else {
+				neighbors = neighborsOf(x, y, len, height);
+			}
+
+			// Left, right, below and above, in that order
+			if (neighbors & NEIGHBOR_LEFT) grow(x - 1, y, (x & mask) ? index - (1 << bits) : across(x - 1, y));
+			if (neighbors & NEIGHBOR_RIGHT) grow(x + 1, y, ((x + 1) & mask) ? index + (1 << bits) : across(x + 1, y));
+			if (neighbors & NEIGHBOR_BELOW) grow(x, y + 1, ((y + 1) & mask) ? index + 1 : across(x, y + 1));
+			if (neighbors & NEIGHBOR_ABOVE) grow(x, y - 1, (y & mask) ? index - 1 : across(x, y - 1));
+
+			// Then the corners, if the rules grow them
+			if constexpr (Rules::diagonalGrowth) {
+				const bool leftIn = x & mask;
+				const bool rightIn = (x + 1) & mask;
+				const bool belowIn = (y + 1) & mask;
+				const bool aboveIn = y & mask;
+				if (neighbors & NEIGHBOR_LEFT_BELOW) {
+					grow(x - 1, y + 1, (leftIn && belowIn) ? index - (1 << bits) + 1 : across(x - 1, y + 1));
+				}
+				if (neighbors & NEIGHBOR_RIGHT_BELOW) {
+					grow(x + 1, y + 1, (rightIn && belowIn) ? index + (1 << bits) + 1 : across(x + 1, y + 1));
+				}
+				if (neighbors & NEIGHBOR_LEFT_ABOVE) {
+					grow(x - 1, y - 1, (leftIn && aboveIn) ? index - (1 << bits) - 1 : across(x - 1, y - 1));
+				}
+				if (neighbors & NEIGHBOR_RIGHT_ABOVE) {
+					grow(x + 1, y - 1, (rightIn && aboveIn) ? index + (1 << bits) - 1 : across(x + 1, y - 1));
+				}
+			}
+		}
+	}
+	waves = wave;
+	return popped;
+}
+
+// Play a move that validateMove accepted, using up a turn
+MoveResult GameEngine::applyMove(const vector<JGraph::Point<int>>& moves) {
+	return withRules(ruleSet, [&](auto rules) { return applyMoveWith<decltype(rules)>(moves); });
+}
+
+template <class Rules>
+MoveResult GameEngine::applyMoveWith(const vector<JGraph::Point<int>>& moves) {
+	PhaseTimer timer(Phase::gameProcedure);
+	PerfScope counters(PerfKernel::gameProcedure);
+	MoveResult result = { 0, 0, 0, 0, 0 };
+
+	// Begin move processing
+	// Each acquired tile scores by the rules' tileScore
+	// After move, all tiles will grow in size, at the rules' popSize (3x classically) they pop
+	// Popped tiles add the rules' chainBonus (classically 0.2x of base score per pop)
+	// Popped tiles can cause chain reactions
+
+	int moveScore = 0;
+	for (int i = 0; i < moves.size(); i++) {
+		if (tiles[moves[i].x][moves[i].y].type == Tile::TileType::empty) continue;
+		// Pop tile, add score, flip boolean flag
+		tiles[moves[i].x][moves[i].y].type = Tile::TileType::empty;
+
+		moveScore += Rules::tileScore(tiles[moves[i].x][moves[i].y].size, moves.size());
+		popQueue.push(moves[i]);
+		result.tiles++;
+	}
+	
+	// Grow outside and if they are about to pop, add to pop stack
+	int chainMultiplier = 0;
+	if (lowestinColumn.size() != len()) lowestinColumn.assign(len(), -1);
+
+	// Tiles popped by one wave grow and pop the next wave
+	if (len() == BOARD_LEN && height() == BOARD_HEIGHT) chainMultiplier = popCascade<Rules, BOARD_LEN, BOARD_HEIGHT>(result.waves);
+	else if (len() == 12 && height() == 8) chainMultiplier = popCascade<Rules, 12, 8>(result.waves);
+	else if (len() == 16 && height() == 10) chainMultiplier = popCascade<Rules, 16, 10>(result.waves);
+	else chainMultiplier = popCascade<Rules, 0, 0>(result.waves);
+
+	// The move's own tiles are the first wave
+	result.popped = chainMultiplier - result.tiles;
+	if (result.waves > 0) result.waves--;
+	result.scoreDelta = moveScore + Rules::chainBonus(moveScore, chainMultiplier);
+	gameScore += result.scoreDelta;
+
+	// Drop tiles down and fill the top, left to right like tileFall so the
+	// new tiles come out in the same order
+	{
+		PhaseTimer fallTimer(Phase::tileFall);
+		PerfScope fallCounters(PerfKernel::tileFall);
+		sort(touchedColumns.begin(), touchedColumns.end());
+		for (int i = 0; i < touchedColumns.size(); i++) {
+			columnFall(touchedColumns[i], lowestinColumn[touchedColumns[i]]);
+			lowestinColumn[touchedColumns[i]] = -1;
+		}
+		result.columns = touchedColumns.size();
+		touchedColumns.clear();
+	}
+
+	turnsLeft--;
+	return result;
+}
+
+// Independent copy of the game, generator included
+GameEngine GameEngine::clone() const {
+	return *this;
+}
+
+// Freeze the game as it is now
+GameSnapshot GameEngine::snapshot() {
+	return { tiles.snapshot(), gameScore, turnsLeft, rng, ruleSet };
+}
+
+// Go back to a snapshot, copying only the parts of the board that differ
+void GameEngine::restore(const GameSnapshot& snapshot) {
+	tiles.restore(snapshot.board);
+	gameScore = snapshot.score;
+	turnsLeft = snapshot.turns;
+	rng = snapshot.rng;
+	ruleSet = snapshot.rules;
+	groupsStale = true;
+}
+
+// Remember game as it is before a move
+void GameHistory::push(GameEngine& game) {
+	undone.push_back(game.snapshot());
+	redone.clear();
+}
+
+// Take back the last move
+bool GameHistory::undo(GameEngine& game) {
+	if (undone.empty()) return false;
+	redone.push_back(game.snapshot());
+	game.restore(undone.back());
+	undone.pop_back();
+	return true;
+}
+
+// Play the last move taken back again
+bool GameHistory::redo(GameEngine& game) {
+	if (redone.empty()) return false;
+	undone.push_back(game.snapshot());
+	game.restore(redone.back());
+	redone.pop_back();
+	return true;
+}
+
+// Groups of the board, caught up with the columns that fell since the last call
+const GroupIndex& GameEngine::groups() {
+	if (groupsStale) {
+		tileGroups.build(tiles);
+		fallenRows.assign(len(), -1);
+		fallenColumns.clear();
+		groupsStale = false;
+	}
+	else if (!fallenColumns.empty()) {
+		tileGroups.update(tiles, fallenColumns, fallenRows);
+		fallenColumns.clear();
+	}
+	return tileGroups;
+}
+
+// Work out every group of board from scratch
+void GroupIndex::build(const Board& board) {
+	len = board.size();
+	height = len ? board[0].size() : 0;
+	label.assign(len * height, -1);
+	next.assign(len * height, -1);
+	sizes.clear();
+	first.clear();
+	freeGroups.clear();
+	sizeCount.assign(len * height + 1, 0);
+	playableGroups = 0;
+	largestSize = 0;
+	for (int cell = 0; cell < len * height; cell++) {
+		flood(board, cell);
+	}
+}
+
+// Catch up with board after the top rows of some columns changed color
+void GroupIndex::update(const Board& board, const vector<int>& columns, vector<int>& rows) {
+	// Any group in the rows that changed, or next to them, may have split or
+	// joined another; its tiles go back into work to be grouped again
+	work.clear();
+	for (int i = 0; i < columns.size(); i++) {
+		int x = columns[i];
+		int bottom = min(rows[x] + 1, height - 1);
+		rows[x] = -1;
+		for (int nx = max(x - 1, 0); nx <= min(x + 1, len - 1); nx++) {
+			for (int y = 0; y <= bottom; y++) {
+				int group = label[nx * height + y];
+				if (group >= 0) release(group);
+			}
+		}
+	}
+	for (int i = 0; i < work.size(); i++) {
+		flood(board, work[i]);
+	}
+	while (largestSize > 0 && sizeCount[largestSize] == 0) {
+		largestSize--;
+	}
+}
+
+// Every tile in the group of (x, y)
+void GroupIndex::members(int x, int y, vector<JGraph::Point<int>>& out) const {
+	out.clear();
+	int group = groupOf(x, y);
+	if (group < 0) return;
+	for (int cell = first[group]; cell >= 0; cell = next[cell]) {
+		out.push_back({ cell / height, cell % height });
+	}
+}
+
+// Forget a group, putting its tiles in work
+void GroupIndex::release(int group) {
+	for (int cell = first[group]; cell >= 0; cell = next[cell]) {
+		label[cell] = -1;
+		work.push_back(cell);
+	}
+	sizeCount[sizes[group]]--;
+	if (sizes[group] >= GROUP_MIN_TILES) playableGroups--;
+	sizes[group] = 0;
+	freeGroups.push_back(group);
+}
+
+// Make a new group of cell and every tile of its color it reaches, unless
+// it already has one or is blocked or empty
+void GroupIndex::flood(const Board& board, int cell) {
+	Tile::TileType type = board[cell / height][cell % height].type;
+	if (label[cell] >= 0 || type == Tile::TileType::BLOCKED || type == Tile::TileType::empty) return;
+
+	int group;
+	if (!freeGroups.empty()) {
+		group = freeGroups.back();
+		freeGroups.pop_back();
+	}
+	else {
+		group = sizes.size();
+		sizes.push_back(0);
+		first.push_back(-1);
+	}
+
+	int size = 1;
+	label[cell] = group;
+	next[cell] = -1;
+	first[group] = cell;
+	stack.push_back(cell);
+	while (!stack.empty()) {
+		int x = stack.back() / height;
+		int y = stack.back() % height;
+		stack.pop_back();
+		for (int nx = max(x - 1, 0); nx <= min(x + 1, len - 1); nx++) {
+			for (int ny = max(y - 1, 0); ny <= min(y + 1, height - 1); ny++) {
+				int neighbor = nx * height + ny;
+				if (label[neighbor] >= 0 || board[nx][ny].type != type) continue;
+				label[neighbor] = group;
+				next[neighbor] = first[group];
+				first[group] = neighbor;
+				stack.push_back(neighbor);
+				size++;
+			}
+		}
+	}
+
+	sizes[group] = size;
+	sizeCount[size]++;
+	if (size >= GROUP_MIN_TILES) playableGroups++;
+	if (size > largestSize) largestSize = size;
+}
+
+// The board as a JGraph canvas, walking only the chunks that changed since the last one
+JGraph::Canvas GameEngine::canvas(JGraph::allocator_type alloc) {
+	drawn.update(tiles);
+	return boardCanvas(tiles, gameScore, turnsLeft, alloc, &drawn);
+}
+
+// Render the board to fileName
+int GameEngine::render(string fileName, int deadline) {
+	PhaseTimer timer(Phase::canvas);
+	JGraph::Canvas boardCanvas = canvas();
+	timer.stop();
+	return JGraph::jgraphToJPG(boardCanvas, fileName, true, deadline);
+}
+
+// Fill testgraph with a board, its score and turns left, scale times the size a game draws it
+void boardGraph(JGraph::Graph& testgraph, const Board& tiles, long boardScore, int turnsLeft, float scale,
+	const BoardPoints* points) {
+	if (tiles.size() == 0) return;
+
+	// Tiles are the same size on any board, 9x6 takes up 6x4 inches
+	float width = tiles.size();
+	float height = tiles[0].size();
+
+	// X axis has no axis, only marks to build grid
+	JGraph::Axis& xaxis = testgraph.xaxis;
+	xaxis.size_inches = 6 * scale * (width / BOARD_LEN);
+	xaxis.min = 0;
+	xaxis.max = width;
+	xaxis.hash_spacing = 1;
+	xaxis.minor_hash_count = 0;
+	xaxis.grid_lines = true;
+	xaxis.minor_grid_lines = false;
+	xaxis.mgrid_color = JGraph::Gray(.625);
+	xaxis.draw = false;
+
+	// Y axis has no axis, only marks to build grid
+	JGraph::Axis& yaxis = testgraph.yaxis;
+	yaxis.size_inches = 4 * scale * (height / BOARD_HEIGHT);
+	yaxis.min = 0;
+	yaxis.max = height;
+	yaxis.hash_spacing = 1;
+	yaxis.minor_hash_count = 0;
+	yaxis.grid_lines = true;
+	yaxis.minor_grid_lines = false;
+	yaxis.mgrid_color = JGraph::Gray(.625);
+	yaxis.draw = false;
+
+	// 15 tile curves, 3 backgrounds and 2 texts, allocated once
+	testgraph.curves.reserve(20);
+
+	// The sizes of each color only differ in marksize, so keep them next to
+	// each other and let the medium and large ones be copycurves
+	testgraph.copy_curves = true;
+
+	///////////////////// Red Shapes //////////////////////////
+	// Red Small
+	testgraph.curves.emplace_back();
+	testgraph.curves[0].lineType = JGraph::Curve::LineType::none;
+	testgraph.curves[0].curveColor = JGraph::Color(0.2, 0, 0);
+	testgraph.curves[0].points = { };
+	JGraph::GeneralMark* redSmallMark = testgraph.curves.back().makeMark<JGraph::GeneralMark>();
+	redSmallMark->type = JGraph::GeneralMark::Type::general;
+	redSmallMark->points = { {-1,-0.25},{-1,0.25},{-0.25,0.25},{-0.25,1},{0.25,1},{0.25,0.25},{1,0.25},{1,-0.25},{0.25,-0.25},{0.25,-1},{-0.25,-1},{-0.25,-0.25} };
+	redSmallMark->size = { .925/3, .925/3 };
+	redSmallMark->pattern = JGraph::GeneralMark::FillPattern::solid;
+	redSmallMark->fill_rotate_angle = 15;
+	redSmallMark->color = JGraph::Color(1,0.2,0.20);
+
+	// Red Medium
+	testgraph.curves.emplace_back();
+	testgraph.curves[1].lineType = JGraph::Curve::LineType::none;
+	testgraph.curves[1].curveColor = JGraph::Color(0.2, 0, 0);
+	testgraph.curves[1].points = { };
+	JGraph::GeneralMark* redMediumMark = testgraph.curves.back().makeMark<JGraph::GeneralMark>();
+	redMediumMark->type = JGraph::GeneralMark::Type::general;
+	redMediumMark->points = { {-1,-0.25},{-1,0.25},{-0.25,0.25},{-0.25,1},{0.25,1},{0.25,0.25},{1,0.25},{1,-0.25},{0.25,-0.25},{0.25,-1},{-0.25,-1},{-0.25,-0.25} };
+	redMediumMark->size = { .925/1.5, .925/ 1.5 };
+	redMediumMark->pattern = JGraph::GeneralMark::FillPattern::solid;
+	redMediumMark->fill_rotate_angle = 15;
+	redMediumMark->color = JGraph::Color(1, 0.2, 0.20);
+
+	// Red Large
+	testgraph.curves.emplace_back();
+	testgraph.curves[2].lineType = JGraph::Curve::LineType::none;
+	testgraph.curves[2].curveColor = JGraph::Color(0.2, 0, 0);
+	testgraph.curves[2].points = { };
+	JGraph::GeneralMark* redLargeMark = testgraph.curves.back().makeMark<JGraph::GeneralMark>();
+	redLargeMark->type = JGraph::GeneralMark::Type::general;
+	redLargeMark->points = { {-1,-0.25},{-1,0.25},{-0.25,0.25},{-0.25,1},{0.25,1},{0.25,0.25},{1,0.25},{1,-0.25},{0.25,-0.25},{0.25,-1},{-0.25,-1},{-0.25,-0.25} };
+	redLargeMark->size = { .925, .925 };
+	redLargeMark->pattern = JGraph::GeneralMark::FillPattern::solid;
+	redLargeMark->fill_rotate_angle = 15;
+	redLargeMark->color = JGraph::Color(1, 0.2, 0.20);
+
+	///////////////////// Green Shapes //////////////////////////
+	// Green Small
+	testgraph.curves.emplace_back();
+	testgraph.curves[3].lineType = JGraph::Curve::LineType::none;
+	testgraph.curves[3].curveColor = JGraph::Color(0, 0.2, 0);
+	testgraph.curves[3].points = { };
+	JGraph::ShapeMark* greenSmallMark = testgraph.curves.back().makeMark<JGraph::ShapeMark>();
+	greenSmallMark->type = JGraph::ShapeMark::Type::triangle;
+	greenSmallMark->size = { .925/3, .925/3 };
+	greenSmallMark->pattern = JGraph::ShapeMark::FillPattern::solid;
+	greenSmallMark->fill_rotate_angle = 30;
+	greenSmallMark->color = JGraph::Color(0, 0.5, 0.17);
+
+	// Green Medium
+	testgraph.curves.emplace_back();
+	testgraph.curves[4].lineType = JGraph::Curve::LineType::none;
+	testgraph.curves[4].curveColor = JGraph::Color(0, 0.2, 0);
+	testgraph.curves[4].points = { };
+	JGraph::ShapeMark* greenMediumMark = testgraph.curves.back().makeMark<JGraph::ShapeMark>();
+	greenMediumMark->type = JGraph::ShapeMark::Type::triangle;
+	greenMediumMark->size = { .925/ 1.5, .925/ 1.5 };
+	greenMediumMark->pattern = JGraph::ShapeMark::FillPattern::solid;
+	greenMediumMark->fill_rotate_angle = 30;
+	greenMediumMark->color = JGraph::Color(0, 0.5, 0.17);
+
+	// Green Large
+	testgraph.curves.emplace_back();
+	testgraph.curves[5].lineType = JGraph::Curve::LineType::none;
+	testgraph.curves[5].curveColor = JGraph::Color(0, 0.2, 0);
+	testgraph.curves[5].points = { };
+	JGraph::ShapeMark* greenLargeMark = testgraph.curves.back().makeMark<JGraph::ShapeMark>();
+	greenLargeMark->type = JGraph::ShapeMark::Type::triangle;
+	greenLargeMark->size = { .925, .925 };
+	greenLargeMark->pattern = JGraph::ShapeMark::FillPattern::solid;
+	greenLargeMark->fill_rotate_angle = 30;
+	greenLargeMark->color = JGraph::Color(0, 0.5, 0.17);
+
+	///////////////////// Blue Shapes //////////////////////////
+	// Blue Small
+	testgraph.curves.emplace_back();
+	testgraph.curves[6].lineType = JGraph::Curve::LineType::none;
+	testgraph.curves[6].curveColor = JGraph::Color(0, 0, 0.2);
+	testgraph.curves[6].points = { };
+	JGraph::ShapeMark* blueSmallMark = testgraph.curves.back().makeMark<JGraph::ShapeMark>();
+	blueSmallMark->type = JGraph::ShapeMark::Type::circle;
+	blueSmallMark->size = { .850/3, .850/3 };
+	blueSmallMark->pattern = JGraph::ShapeMark::FillPattern::solid;
+	blueSmallMark->color = JGraph::Color(0, 0.47, 0.7);
+
+	// Blue Medium
+	testgraph.curves.emplace_back();
+	testgraph.curves[7].lineType = JGraph::Curve::LineType::none;
+	testgraph.curves[7].curveColor = JGraph::Color(0, 0, 0.2);
+	testgraph.curves[7].points = { };
+	JGraph::ShapeMark* blueMediumMark = testgraph.curves.back().makeMark<JGraph::ShapeMark>();
+	blueMediumMark->type = JGraph::ShapeMark::Type::circle;
+	blueMediumMark->size = { .850/ 1.5, .850/ 1.5 };
+	blueMediumMark->pattern = JGraph::ShapeMark::FillPattern::solid;
+	blueMediumMark->color = JGraph::Color(0, 0.47, 0.7);
+
+	// Blue Large
+	testgraph.curves.emplace_back();
+	testgraph.curves[8].lineType = JGraph::Curve::LineType::none;
+	testgraph.curves[8].curveColor = JGraph::Color(0, 0, 0.2);
+	testgraph.curves[8].points = { };
+	JGraph::ShapeMark* blueLargeMark = testgraph.curves.back().makeMark<JGraph::ShapeMark>();
+	blueLargeMark->type = JGraph::ShapeMark::Type::circle;
+	blueLargeMark->size = { .850, .850 };
+	blueLargeMark->pattern = JGraph::ShapeMark::FillPattern::solid;
+	blueLargeMark->color = JGraph::Color(0, 0.47, 0.7);
+
+	///////////////////// Purple Shapes //////////////////////////
+	// Purple Small
+	testgraph.curves.emplace_back();
+	testgraph.curves[9].lineType = JGraph::Curve::LineType::none;
+	testgraph.curves[9].curveColor = JGraph::Color(0.2, 0, 0.2);
+	testgraph.curves[9].points = { };
+	JGraph::ShapeMark* purpleSmallMark = testgraph.curves.back().makeMark<JGraph::ShapeMark>();
+	purpleSmallMark->type = JGraph::ShapeMark::Type::diamond;
+	purpleSmallMark->size = { .925/3, .925/3 };
+	purpleSmallMark->pattern = JGraph::ShapeMark::FillPattern::solid;
+	purpleSmallMark->color = JGraph::Color(0.9, 0, 0.75);
+
+	// Purple Medium
+	testgraph.curves.emplace_back();
+	testgraph.curves[10].lineType = JGraph::Curve::LineType::none;
+	testgraph.curves[10].curveColor = JGraph::Color(0.2, 0, 0.2);
+	testgraph.curves[10].points = { };
+	JGraph::ShapeMark* purpleMediumMark = testgraph.curves.back().makeMark<JGraph::ShapeMark>();
+	purpleMediumMark->type = JGraph::ShapeMark::Type::diamond;
+	purpleMediumMark->size = { .925/ 1.5, .925/ 1.5 };
+	purpleMediumMark->pattern = JGraph::ShapeMark::FillPattern::solid;
+	purpleMediumMark->color = JGraph::Color(0.9, 0, 0.75);
+
+	// Purple Large
+	testgraph.curves.emplace_back();
+	testgraph.curves[11].lineType = JGraph::Curve::LineType::none;
+	testgraph.curves[11].curveColor = JGraph::Color(0.2, 0, 0.2);
+	testgraph.curves[11].points = { };
+	JGraph::ShapeMark* purpleLargeMark = testgraph.curves.back().makeMark<JGraph::ShapeMark>();
+	purpleLargeMark->type = JGraph::ShapeMark::Type::diamond;
+	purpleLargeMark->size = { .925, .925 };
+	purpleLargeMark->pattern = JGraph::ShapeMark::FillPattern::solid;
+	purpleLargeMark->color = JGraph::Color(0.9, 0, 0.75);
+
+	///////////////////// Yellow Shapes //////////////////////////
+	// Yellow Small
+	testgraph.curves.emplace_back();
+	testgraph.curves[12].lineType = JGraph::Curve::LineType::none;
+	testgraph.curves[12].curveColor = JGraph::Color(0.2, 0.2, 0);
+	testgraph.curves[12].points = { };
+	JGraph::GeneralMark* yellowSmallMark = testgraph.curves.back().makeMark<JGraph::GeneralMark>();
+	yellowSmallMark->type = JGraph::GeneralMark::Type::general;
+	yellowSmallMark->points = { {-1,-1}, {-0.5,0}, {-1,1}, {0,0.5}, {1,1}, {0.5,0}, {1,-1}, {0,-0.5} };
+	yellowSmallMark->size = { .925/3, .925/3 };
+	yellowSmallMark->pattern = JGraph::GeneralMark::FillPattern::solid;
+	yellowSmallMark->color = JGraph::Color(1, 0.9, 0.0);
+
+	// Yellow Medium
+	testgraph.curves.emplace_back();
+	testgraph.curves[13].lineType = JGraph::Curve::LineType::none;
+	testgraph.curves[13].curveColor = JGraph::Color(0.2, 0.2, 0);
+	testgraph.curves[13].points = { };
+	JGraph::GeneralMark* yellowMediumMark = testgraph.curves.back().makeMark<JGraph::GeneralMark>();
+	yellowMediumMark->type = JGraph::GeneralMark::Type::general;
+	yellowMediumMark->points = { {-1,-1}, {-0.5,0}, {-1,1}, {0,0.5}, {1,1}, {0.5,0}, {1,-1}, {0,-0.5} };
+	yellowMediumMark->size = { .925/ 1.5, .925/ 1.5 };
+	yellowMediumMark->pattern = JGraph::GeneralMark::FillPattern::solid;
+	yellowMediumMark->color = JGraph::Color(1, 0.9, 0.0);
+
+	// Yellow Large
+	testgraph.curves.emplace_back();
+	testgraph.curves[14].lineType = JGraph::Curve::LineType::none;
+	testgraph.curves[14].curveColor = JGraph::Color(0.2, 0.2, 0);
+	testgraph.curves[14].points = { };
+	JGraph::GeneralMark* yellowLargeMark = testgraph.curves.back().makeMark<JGraph::GeneralMark>();
+	yellowLargeMark->type = JGraph::GeneralMark::Type::general;
+	yellowLargeMark->points = { {-1,-1}, {-0.5,0}, {-1,1}, {0,0.5}, {1,1}, {0.5,0}, {1,-1}, {0,-0.5} };
+	yellowLargeMark->size = { .925, .925 };
+	yellowLargeMark->pattern = JGraph::GeneralMark::FillPattern::solid;
+	yellowLargeMark->color = JGraph::Color(1, 0.9, 0.0);
+
+
+	/////////////////////////////////
+	// White Space
+	testgraph.curves.emplace_back();
+	testgraph.curves[15].lineType = JGraph::Curve::LineType::none;
+	testgraph.curves[15].curveColor = JGraph::Color(1, 1, 1);
+	testgraph.curves[15].points = { {0,0}, {0,height}, {width,0}, {width,height} };
+	JGraph::ShapeMark* whitespace = testgraph.curves.back().makeMark<JGraph::ShapeMark>();
+	whitespace->type = JGraph::ShapeMark::Type::box;
+	whitespace->size = { 1.975, 1.975 };
+	whitespace->pattern = JGraph::ShapeMark::FillPattern::solid;
+	whitespace->color = JGraph::Color(1, 1, 1);
+
+	// Score space
+	testgraph.curves.emplace_back();
+	testgraph.curves[16].lineType = JGraph::Curve::LineType::none;
+	testgraph.curves[16].curveColor = JGraph::Color(0, 0, 0);
+	testgraph.curves[16].points = { {0,height + 0.5F} };
+	JGraph::GeneralMark* Scorespace = testgraph.curves.back().makeMark<JGraph::GeneralMark>();
+	Scorespace->type = JGraph::GeneralMark::Type::general;
+	Scorespace->points = { {0,0},{0,5},{5,5},{3,0} };
+	Scorespace->size = { 1.975, 1.975 };
+	Scorespace->pattern = JGraph::GeneralMark::FillPattern::solid;
+	Scorespace->color = JGraph::Color(0.8, 0.7, 1);
+
+	// Turn Space
+	testgraph.curves.emplace_back();
+	testgraph.curves[17].lineType = JGraph::Curve::LineType::none;
+	testgraph.curves[17].curveColor = JGraph::Color(0, 0, 0);
+	testgraph.curves[17].points = { {width - 4.75F,height + 0.5F} };
+	JGraph::GeneralMark* TurnSpace = testgraph.curves.back().makeMark<JGraph::GeneralMark>();
+	TurnSpace->type = JGraph::GeneralMark::Type::general;
+	TurnSpace->points = { {5,5},{0,5},{3,0},{5,0} };
+	TurnSpace->size = { 1.975, 1.975 };
+	TurnSpace->pattern = JGraph::GeneralMark::FillPattern::solid;
+	TurnSpace->color = JGraph::Color(0.8, 0.7, 1);
+
+	// Score text
+	testgraph.curves.emplace_back();
+	JGraph::Curve& Scoretext = testgraph.curves.back();
+	Scoretext.lineType = JGraph::Curve::LineType::none;
+	Scoretext.points = { {1.5, height + 1} };
+	JGraph::TextMark* textMark = testgraph.curves.back().makeMark<JGraph::TextMark>();
+	textMark->text.font = "Arial";
+	textMark->text.size = 20 * scale;
+	textMark->text.line_spacing = 20 * scale;
+	textMark->text.content = "Score: \n";
+	textMark->text.content += to_string(boardScore);
+
+	// Text showing turn count
+	testgraph.curves.emplace_back();
+	JGraph::Curve& Turntext = testgraph.curves.back();
+	Turntext.lineType = JGraph::Curve::LineType::none;
+	Turntext.points = { {width - 1, height + 1} };
+	JGraph::TextMark* turnTextMark = testgraph.curves.back().makeMark<JGraph::TextMark>();
+	turnTextMark->text.font = "Arial";
+	turnTextMark->text.size = 20 * scale;
+	turnTextMark->text.line_spacing = 20 * scale;
+	turnTextMark->text.content = "Turns: \n";
+	turnTextMark->text.content += to_string(turnsLeft);
+	
+	// add points to each curve based on their tile type and size
+	if (points) {
+		points->addTo(testgraph);
+		return;
+	}
+	for (int chunk = 0; chunk < tiles.chunkCount(); chunk++) {
+		chunkPoints(tiles, chunk, [&](int curve, JGraph::Point<float> point) {
+			testgraph.curves[curve].points.push_back(point);
+		});
+	}
+}
+
+// Draw moves over a board graph as a line with a dot on each tile
+void moveGraph(JGraph::Graph& graph, int height, const vector<JGraph::Point<int>>& moves) {
+	graph.curves.emplace_back();
+	JGraph::Curve& path = graph.curves.back();
+	path.lineType = JGraph::Curve::LineType::linesolid;
+	path.lineThickness = 4;
+	path.curveColor = JGraph::Color(0, 0, 0);
+	for (int i = 0; i < moves.size(); i++) {
+		path.points.push_back({ moves[i].x + 0.5F, (height - 1 - moves[i].y) + 0.5F });
+	}
+	JGraph::ShapeMark* dot = path.makeMark<JGraph::ShapeMark>();
+	dot->type = JGraph::ShapeMark::Type::circle;
+	dot->size = { 0.3, 0.3 };
+	dot->color = JGraph::Color(1, 1, 1);
+}
+
+// Build the JGraph canvas for a board, its score and turns left
+JGraph::Canvas boardCanvas(const Board& tiles, long boardScore, int turnsLeft, JGraph::allocator_type alloc,
+	const BoardPoints* points) {
+	// Canvas, contains graphs, set to boundaries required
+	JGraph::Canvas testcanvas(alloc);
+	if (tiles.size() == 0) return testcanvas;
+	testcanvas.size.height = 4 * ((float)tiles[0].size() / BOARD_HEIGHT);
+	testcanvas.size.width = 6 * ((float)tiles.size() / BOARD_LEN);
+	testcanvas.bounding_box.X = 0;
+	testcanvas.bounding_box.Y = -3;
+	testcanvas.bounding_box.width = testcanvas.size.width*72;
+	testcanvas.bounding_box.height = (testcanvas.size.height + 1)*72;
+	testcanvas.graphs.emplace_back();
+	boardGraph(testcanvas.graphs[0], tiles, boardScore, turnsLeft, 1, points);
+
+	return testcanvas;
+}
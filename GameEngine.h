@@ -0,0 +1,567 @@
+#ifndef GAMEENGINE_H
+#define GAMEENGINE_H
+
+#include "JGraph.h"
+#include "Rules.h"
+#include <vector>
+#include <queue>
+#include <memory>
+#include <random>
+#include <string>
+#include <cstdint>
+
+using namespace std;
+
+/*
+ * The puzzle itself: tiles, the board, the rules and drawing a board, with
+ * no global state. Everything a game needs lives in a GameEngine, so any
+ * number of them can run side by side on different threads (one engine
+ * per thread at a time). Nothing here prints; every failure comes back as
+ * a status. Built into libpuzzleengine.a, implemented in GameEngine.cpp.
+ *
+ *   GameEngine game;
+ *   game.seed(1);
+ *   game.newGame(9, 6);
+ *   vector<JGraph::Point<int>> moves;
+ *   int badMove;
+ *   if (game.validateMove("{(1,1),(1,2),(1,3)}", moves, badMove) == 0) {
+ *       MoveResult result = game.applyMove(moves);
+ *   }
+ *   game.render("board.jpg");
+ *
+ * The rules themselves (pop size, growth, scoring, turns and blocked tiles)
+ * come from the game's rule set, see Rules.h.
+ *
+ * Phase timings, traces and hardware counters (Stats.h, Trace.h,
+ * PerfCounters.h) are still recorded for the whole process.
+ */
+
+// Tile class -- Contains type information, size information, and methods to initalize them and reset them
+class Tile {
+public:
+	enum class TileType : unsigned char {
+		red = 0,
+		green = 1,
+		blue = 2,
+		purple = 3,
+		yellow = 4,
+		BLOCKED = 5,
+		empty = 6
+	};
+
+	inline string tileTypeToString() {
+		switch (type) {
+		case TileType::red: return "red";
+		case TileType::green: return "green";
+		case TileType::blue: return "blue";
+		case TileType::purple: return "purple";
+		case TileType::yellow: return "yellow";
+		default: return "";
+		}
+	}
+
+	TileType type;
+	unsigned char size;
+
+	// Empty until dealt with initTile
+	Tile() {
+		type = TileType::empty;
+		size = 0;
+	}
+
+
+	Tile(TileType typ, int state) {
+		type = typ;
+		size = state;
+	}
+
+	void resetTile(minstd_rand& rng) {
+		size = 0;
+		type = (TileType)(rng() % 5);
+	}
+
+	void initTile(minstd_rand& rng) {
+		size = (rng() % 3);
+		type = (TileType)(rng() % 5);
+	}
+
+};
+
+// Default board size, and the limits --size accepts
+#define BOARD_LEN 9
+#define BOARD_HEIGHT 6
+#define BOARD_MIN 3
+#define BOARD_MAX 4096
+
+// Curves of a board graph that hold tiles, one per color and size (color * 3 + size)
+#define TILE_CURVES 15
+
+// A board frozen at one moment (see Board::snapshot). Chunks that didn't
+// change between snapshots are shared by them, so each snapshot costs a
+// pointer per chunk plus a copy of the chunks changed since the one before,
+// and a snapshot of a board that hasn't changed costs nothing.
+class BoardSnapshot {
+public:
+	BoardSnapshot() {
+		len = 0;
+		height = 0;
+	}
+	int size() const {
+		return len;
+	}
+	int rows() const {
+		return height;
+	}
+
+private:
+	friend class Board;
+	typedef vector<shared_ptr<const vector<Tile> > > ChunkTable;
+
+	int len;
+	int height;
+	shared_ptr<const ChunkTable> chunks;
+};
+
+// Tiles of a board, stored in square chunks of up to 64x64 tiles so that
+// neighbours stay close in memory whatever the size of the board. board[x][y]
+// is the tile at (x, y).
+//
+// Each chunk has a dirty flag so a board can be redrawn by walking only the
+// chunks that changed (see BoardPoints), and an unsaved flag so a snapshot
+// only copies the chunks that changed since the last one. The engine marks
+// every tile it changes; anything else that writes through board[x][y] has
+// to call markDirty. Resizing, copying or assigning a board marks all of it
+// dirty.
+class Board {
+public:
+	static const int CHUNK_BITS = 6;
+
+	// One column of a board. Its chunks are next to each other in memory, so
+	// only the row needs working out.
+	template <class T>
+	class Column {
+	public:
+		Column(T* top, int bits, int height) : top(top), bits(bits), height(height) {
+			gap = (1 << (2 * bits)) - (1 << bits);
+		}
+		// Every chunk down, skip the other columns of the chunk above
+		T& operator[](int y) const {
+			return top[y + (y >> bits) * gap];
+		}
+		int size() const {
+			return height;
+		}
+	private:
+		T* top;
+		int bits;
+		int gap;
+		int height;
+	};
+
+	Board() {
+		len = 0;
+		height = 0;
+		bits = 0;
+		chunksHigh = 0;
+	}
+	Board(const Board& other);
+	Board(Board&& other);
+	Board& operator=(const Board& other);
+	Board& operator=(Board&& other);
+
+	Column<Tile> operator[](int x) {
+		return Column<Tile>(&tiles[indexOf(x, 0)], bits, height);
+	}
+	Column<const Tile> operator[](int x) const {
+		return Column<const Tile>(&tiles[indexOf(x, 0)], bits, height);
+	}
+
+	// Number of columns
+	int size() const {
+		return len;
+	}
+
+	// Chunks of a len x height board are 2^chunkBitsFor(len, height) tiles on
+	// a side, the smallest that holds the board up to 2^CHUNK_BITS
+	static constexpr int chunkBitsFor(int len, int height) {
+		int bits = 0;
+		while (bits < CHUNK_BITS && ((1 << bits) < len || (1 << bits) < height)) bits++;
+		return bits;
+	}
+
+	// Change the size, keeping the tiles that are on both. New tiles are
+	// dealt from rng in column order, so a seeded game gets the same board it always has.
+	void resize(int len, int height, minstd_rand& rng);
+
+	// Where each tile is in data(), for kernels that keep it in registers
+	// rather than going through board[x][y]
+	struct Layout {
+		int bits;
+		int chunksHigh;
+		int chunkOf(int x, int y) const {
+			return (x >> bits) * chunksHigh + (y >> bits);
+		}
+		int indexOf(int x, int y) const {
+			int mask = (1 << bits) - 1;
+			return (chunkOf(x, y) << (2 * bits)) | ((x & mask) << bits) | (y & mask);
+		}
+	};
+	Layout layout() const {
+		return { bits, chunksHigh };
+	}
+	Tile* data() {
+		return tiles.data();
+	}
+
+	// Chunks, ordered by column of chunks then row
+	int chunkCount() const {
+		return flags.size();
+	}
+	int chunkSide() const {
+		return 1 << bits;
+	}
+	int chunkOf(int x, int y) const {
+		return layout().chunkOf(x, y);
+	}
+	// Top left tile of a chunk
+	int chunkX(int chunk) const {
+		return (chunk / chunksHigh) << bits;
+	}
+	int chunkY(int chunk) const {
+		return (chunk % chunksHigh) << bits;
+	}
+
+	void markDirty(int x, int y) {
+		markChunk(chunkOf(x, y));
+	}
+	void markChunk(int chunk) {
+		if (flags[chunk] == (CHUNK_DIRTY | CHUNK_UNSAVED)) return;
+		if (!(flags[chunk] & CHUNK_DIRTY)) dirtyList.push_back(chunk);
+		if (!(flags[chunk] & CHUNK_UNSAVED)) unsavedList.push_back(chunk);
+		flags[chunk] = CHUNK_DIRTY | CHUNK_UNSAVED;
+	}
+	// Rows top to bottom of column x
+	void markDirty(int x, int top, int bottom) {
+		for (int chunk = chunkOf(x, top); chunk <= chunkOf(x, bottom); chunk++) {
+			markChunk(chunk);
+		}
+	}
+	void markAllDirty();
+
+	// Chunks marked since the last clearDirty, in the order they were marked
+	const vector<int>& dirtyChunks() const {
+		return dirtyList;
+	}
+	void clearDirty();
+
+	// Hash of the size and every tile, equal for boards with equal tiles
+	uint64_t hash() const;
+
+	// Freeze the board as it is now. Costs a copy of each chunk changed since
+	// the last snapshot or restore.
+	BoardSnapshot snapshot();
+
+	// Go back to a snapshot, of this board or any other. Only the chunks that
+	// differ from the last snapshot or restore are copied, so stepping between
+	// nearby snapshots costs about what changed between them.
+	void restore(const BoardSnapshot& snapshot);
+
+private:
+	// Flags of a chunk
+	static const unsigned char CHUNK_DIRTY = 1; // Changed since it was last drawn
+	static const unsigned char CHUNK_UNSAVED = 2; // Changed since the last snapshot or restore
+
+	int chunkTiles() const {
+		return 1 << (2 * bits);
+	}
+	void shape(int len, int height);
+	void copyChunk(const BoardSnapshot& snapshot, int chunk);
+
+	int indexOf(int x, int y) const {
+		return layout().indexOf(x, y);
+	}
+
+	int len;
+	int height;
+	int bits; // Chunks are 2^bits tiles on a side
+	int chunksHigh;
+	vector<Tile> tiles; // Chunk by chunk, each column by column
+	vector<unsigned char> flags;
+	vector<int> dirtyList;
+	vector<int> unsavedList;
+	BoardSnapshot saved; // Last snapshot taken or restored, which unsaved chunks differ from
+};
+
+// Tile points of a board graph kept chunk by chunk, so that the board can be
+// redrawn by walking only the chunks that changed since it was last drawn
+class BoardPoints {
+public:
+	BoardPoints() {
+		len = 0;
+		height = 0;
+	}
+
+	// Catch up with every dirty chunk of tiles, then clear them
+	void update(Board& tiles);
+
+	// Add the points to the tile curves of graph
+	void addTo(JGraph::Graph& graph) const;
+
+private:
+	int len;
+	int height;
+	vector<vector<JGraph::Point<float>>> points; // chunk * TILE_CURVES + curve
+};
+
+// Read a board size written as WxH, false if it isn't one or is out of limits
+bool parseBoardSize(string text, int& len, int& height);
+
+// Fill graph with a board, its score and turns left, scale times the size a game draws it.
+// The tiles come from points if it is given (it must be up to date with tiles).
+// An empty board leaves graph as it is.
+void boardGraph(JGraph::Graph& graph, const Board& tiles, long boardScore, int turnsLeft, float scale = 1,
+	const BoardPoints* points = NULL);
+
+// Build the JGraph canvas for a board, its score and turns left, allocating from alloc.
+// An empty board gets an empty canvas.
+JGraph::Canvas boardCanvas(const Board& tiles, long boardScore, int turnsLeft,
+	JGraph::allocator_type alloc = JGraph::allocator_type(), const BoardPoints* points = NULL);
+
+// Draw moves over a board graph of a board height tiles high, as a line
+// through the tiles in order with a dot on each
+void moveGraph(JGraph::Graph& graph, int height, const vector<JGraph::Point<int>>& moves);
+
+// What a move did
+struct MoveResult {
+	long scoreDelta; // Score the move added
+	int tiles; // Tiles in the move
+	int popped; // Tiles the cascade popped after them
+	int waves; // Waves of the cascade, 0 if nothing popped
+	int columns; // Columns that fell and were refilled
+};
+
+// Fewest tiles a move may take
+#define GROUP_MIN_TILES 3
+
+// Groups of tiles: the tiles of one color joined to each other through any of
+// their eight neighbours, the same rule a move follows. A group of at least
+// GROUP_MIN_TILES can always be played, so a board with none is dead.
+//
+// Each group keeps its members in a list and its size, so membership, group
+// size, the largest group and whether the board is dead are all answered
+// without walking the board. After a move only the groups that touch the
+// rows that fell are worked out again (see update).
+class GroupIndex {
+public:
+	GroupIndex() {
+		len = 0;
+		height = 0;
+		playableGroups = 0;
+		largestSize = 0;
+	}
+
+	// Work out every group of board from scratch
+	void build(const Board& board);
+
+	// Catch up with board after rows 0 to rows[x] of each column x in columns
+	// changed color. rows is -1 for every other column, and is left that way.
+	void update(const Board& board, const vector<int>& columns, vector<int>& rows);
+
+	// Group of the tile at (x, y), -1 if it is blocked or empty
+	int groupOf(int x, int y) const {
+		return label[x * height + y];
+	}
+	// Tiles in the group of (x, y), 0 if it is blocked or empty
+	int groupSize(int x, int y) const {
+		int group = groupOf(x, y);
+		return (group < 0) ? 0 : sizes[group];
+	}
+	bool sameGroup(JGraph::Point<int> a, JGraph::Point<int> b) const {
+		int group = groupOf(a.x, a.y);
+		return group >= 0 && group == groupOf(b.x, b.y);
+	}
+	// Every tile in the group of (x, y), none if it is blocked or empty
+	void members(int x, int y, vector<JGraph::Point<int>>& out) const;
+
+	// Groups of at least GROUP_MIN_TILES
+	int playable() const {
+		return playableGroups;
+	}
+	// No move can be played
+	bool dead() const {
+		return playableGroups == 0;
+	}
+	// Tiles in the biggest group, 0 on an empty board
+	int largest() const {
+		return largestSize;
+	}
+
+private:
+	void release(int group);
+	void flood(const Board& board, int cell);
+
+	int len;
+	int height;
+	vector<int> label; // Group of each tile, x * height + y, -1 for none
+	vector<int> next; // Next tile of the same group, -1 after the last
+	vector<int> sizes; // Of each group, 0 once it is free for reuse
+	vector<int> first; // First tile of each group
+	vector<int> freeGroups;
+	vector<int> sizeCount; // Groups of each size
+	int playableGroups;
+	int largestSize;
+
+	// Scratch space kept between updates
+	vector<int> work;
+	vector<int> stack;
+};
+
+// A game frozen at one moment, see GameEngine::snapshot
+struct GameSnapshot {
+	BoardSnapshot board;
+	long score;
+	int turns;
+	minstd_rand rng; // So the same move deals the same tiles again
+	RuleSet rules;
+};
+
+// One game: its board, score, turns left and tile generator
+class GameEngine {
+public:
+	// Seeded from the system's TRNG, empty until newGame or load
+	GameEngine();
+
+	// Seed the tile generator, so that a recorded game can be replayed exactly
+	void seed(unsigned long value);
+
+	// Rule set of the moves played from now on and of new games, classic
+	// unless set. A save keeps the rules it was played with.
+	void setRules(RuleSet rules) {
+		ruleSet = rules;
+	}
+	RuleSet rules() const {
+		return ruleSet;
+	}
+
+	// Start a new len x height game with the turns and blocked tiles of its rules
+	void newGame(int len = BOARD_LEN, int height = BOARD_HEIGHT);
+
+	// Save the game to fileName
+	int save(string fileName) const;
+
+	// Load a save, leaving the game as it was unless it loads
+	int load(string fileName);
+
+	// Parse a move in the format {(x0,y0),(x1,y1),(x2,y2)....} and check it
+	// against the board. A move can't use a tile twice.
+	int validateMove(string text, vector<JGraph::Point<int>>& moves, int& badMove) const;
+
+	// Play a move that validateMove accepted, using up a turn
+	MoveResult applyMove(const vector<JGraph::Point<int>>& moves);
+
+	// Drop the tiles of every column whose entry isn't -1 down into the empty
+	// spaces at or above that row, and refill the top
+	void tileFall(const vector<int>& columnsToConsider);
+
+	// Independent copy of the game, generator included
+	GameEngine clone() const;
+
+	// Freeze the game as it is now, sharing the board with earlier snapshots
+	// wherever it hasn't changed. Cheap enough to take before every move.
+	GameSnapshot snapshot();
+
+	// Go back to a snapshot of this game or any other, copying only the
+	// parts of the board that differ
+	void restore(const GameSnapshot& snapshot);
+
+	// The board as a JGraph canvas, allocating from alloc. Only the chunks
+	// that changed since the last canvas are walked again.
+	JGraph::Canvas canvas(JGraph::allocator_type alloc = JGraph::allocator_type());
+
+	// Groups of the board, caught up with the columns that fell since the last
+	// call (or worked out again after anything that replaced the board)
+	const GroupIndex& groups();
+
+	// Render the board to fileName, giving up after deadline ms if it isn't 0.
+	// Same statuses as JGraph::jgraphToJPG.
+	int render(string fileName, int deadline = 0);
+
+	const Board& board() const {
+		return tiles;
+	}
+	// Anything written through this has to be marked dirty (see Board), and
+	// the groups are worked out again from scratch
+	Board& board() {
+		groupsStale = true;
+		return tiles;
+	}
+	int len() const {
+		return tiles.size();
+	}
+	int height() const {
+		return tiles.size() ? tiles[0].size() : 0;
+	}
+	long score() const {
+		return gameScore;
+	}
+	int turns() const {
+		return turnsLeft;
+	}
+
+private:
+	template <class Rules>
+	void newGameWith(int len, int height);
+	template <class Rules>
+	MoveResult applyMoveWith(const vector<JGraph::Point<int>>& moves);
+	template <class Rules, int LEN, int HEIGHT>
+	int popCascade(int& waves);
+	void columnFall(int x, int lowest);
+
+	Board tiles;
+	long gameScore;
+	int turnsLeft; // 1 to the rules' turns during a game, 0 once it is over
+	minstd_rand rng;
+	RuleSet ruleSet;
+
+	// Tile points of the last canvas, caught up with the chunks each move changed
+	BoardPoints drawn;
+
+	// Groups as of the last call to groups(), and the lowest row of each
+	// column that fell since (-1 if none). Nothing is kept track of while the
+	// groups are stale, so a game that never asks for them doesn't pay for them.
+	GroupIndex tileGroups;
+	bool groupsStale;
+	vector<int> fallenRows;
+	vector<int> fallenColumns;
+
+	// Scratch space kept between moves so a move doesn't allocate. Lowest pop
+	// in each column is all -1 between moves, so a move only costs the
+	// columns it touches.
+	queue<JGraph::Point<int> > popQueue;
+	vector<int> lowestinColumn;
+	vector<int> touchedColumns;
+};
+
+// Moves that can be taken back and played again
+class GameHistory {
+public:
+	// Remember game as it is before a move, forgetting any moves that were undone
+	void push(GameEngine& game);
+
+	// Take back the last move, false if there isn't one
+	bool undo(GameEngine& game);
+
+	// Play the last move taken back again, false if there isn't one
+	bool redo(GameEngine& game);
+
+	void clear() {
+		undone.clear();
+		redone.clear();
+	}
+
+private:
+	vector<GameSnapshot> undone;
+	vector<GameSnapshot> redone;
+};
+
+#endif
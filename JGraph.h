@@ -3,11 +3,26 @@
 
 #include <string>
 #include <unistd.h>
-#include <ext/stdio_filebuf.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <csignal>
+#include <pthread.h>
+#include <cstdio>
+#include <cstring>
 #include <vector>
 #include <sys/wait.h>
 #include <memory>
+#include <memory_resource>
+#include <variant>
+#include <type_traits>
 #include <cmath>
+#include <sstream>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 using namespace std;
 
@@ -22,15 +37,25 @@ using namespace std;
  * To print the JGraph, call jgraphToJPG with the first argument as a canvas,
  * and the second as a string with the output file name. The third argument
  * is an optional boolean, which can be set to false to disable waiting for
- * JGraph and convert/gs to return.
+ * JGraph and convert/gs to return. The fourth is an optional deadline in
+ * milliseconds; if they take longer they are killed and RENDER_TIMEOUT is
+ * returned, leaving any previous image at that file name untouched.
+ *
+ * Canvas, Graph, Curve, Text, GeneralMark and TextMark take an optional
+ * pmr allocator, and everything they own (graphs, curves, points, strings
+ * and marks) comes from its memory resource. Build
+ * a canvas in an Arena to replace the per-frame heap traffic with pointer
+ * bumps, and reset() the arena once the canvas is gone.
  */
 
 class JGraph {
 private:
 	union Pipe {
 	public:
+		// Close-on-exec so concurrent renders don't leak each other's pipe ends
+		// into their children (which would keep jgraph waiting for EOF)
 		Pipe() {
-			if (pipe(array)) {
+			if (pipe2(array, O_CLOEXEC)) {
 				throw system_error(errno, generic_category());
 			}
 		}
@@ -46,6 +71,38 @@ private:
 		int array[2];
 	};
 public:
+	typedef pmr::polymorphic_allocator<char> allocator_type;
+
+	// Pixels per inch of rendered images (the -density given to convert)
+	static constexpr int RENDER_DENSITY = 300;
+	// Length jgraph gives an axis that has no size, in inches
+	static constexpr float DEFAULT_AXIS_INCHES = 5;
+	// Points a run of curves needs before it is formatted as a task of its
+	// own when serializing in parallel (Canvas::serialize_threads)
+	static constexpr size_t TASK_POINTS = 16384;
+
+	// Part of a script that can be formatted on any thread
+	typedef function<void(ostream&)> ScriptTask;
+
+	// Monotonic memory for building one canvas at a time. Allocations bump a
+	// pointer through a preallocated buffer (going to the heap only if it runs
+	// out) and are all freed by reset(), which must come after every object
+	// built in the arena has been destroyed. Not thread safe; use one per thread.
+	class Arena {
+	public:
+		Arena(size_t bytes) : buffer(new char[bytes]), resource(buffer.get(), bytes) {
+		}
+		pmr::memory_resource* get() {
+			return &resource;
+		}
+		void reset() {
+			resource.release();
+		}
+	private:
+		unique_ptr<char[]> buffer;
+		pmr::monotonic_buffer_resource resource;
+	};
+
 	class Color {
 	public:
 		Color() {
@@ -92,6 +149,93 @@ public:
 		float width;
 		float height;
 	};
+
+	// Points a curve reads from memory it doesn't own, instead of copying them
+	// into Curve::points: an array of points, separate x and y arrays with any
+	// stride (in bytes, so they can be fields of a larger struct), or a
+	// generator called with each index. The memory must outlive the curve.
+	class PointSource {
+	public:
+		PointSource() {
+			kind = Kind::none;
+			count = 0;
+		}
+		PointSource(const Point<float>* points, size_t count) {
+			kind = Kind::points;
+			this->points = points;
+			this->count = count;
+		}
+		PointSource(const float* x, const float* y, size_t count, size_t xStride = sizeof(float), size_t yStride = sizeof(float)) {
+			kind = Kind::strided;
+			strided = { (const char*)x, (const char*)y, xStride, yStride };
+			this->count = count;
+		}
+		PointSource(size_t count, function<Point<float>(size_t)> generator) : generator(move(generator)) {
+			kind = Kind::generator;
+			this->count = count;
+		}
+
+		bool empty() const {
+			return kind == Kind::none;
+		}
+		size_t size() const {
+			return count;
+		}
+
+		// Calls f with an accessor for the points (size() and operator[]) that
+		// reads straight from the source, so the kind is only checked once
+		template <typename F>
+		void visit(F f) const {
+			switch (kind) {
+			case Kind::points: f(Span{ points, count }); break;
+			case Kind::strided: f(Strided{ strided, count }); break;
+			case Kind::generator: f(Generated{ &generator, count }); break;
+			default: break;
+			}
+		}
+
+	private:
+		enum class Kind {
+			none,
+			points,
+			strided,
+			generator
+		};
+
+		struct Arrays {
+			const char* x;
+			const char* y;
+			size_t xStride;
+			size_t yStride;
+		};
+
+		struct Span {
+			const Point<float>* points;
+			size_t count;
+			size_t size() const { return count; }
+			const Point<float>& operator[](size_t i) const { return points[i]; }
+		};
+		struct Strided {
+			Arrays arrays;
+			size_t count;
+			size_t size() const { return count; }
+			Point<float> operator[](size_t i) const {
+				return { *(const float*)(arrays.x + i * arrays.xStride), *(const float*)(arrays.y + i * arrays.yStride) };
+			}
+		};
+		struct Generated {
+			const function<Point<float>(size_t)>* generator;
+			size_t count;
+			size_t size() const { return count; }
+			Point<float> operator[](size_t i) const { return (*generator)(i); }
+		};
+
+		Kind kind;
+		size_t count;
+		const Point<float>* points;
+		Arrays strided;
+		function<Point<float>(size_t)> generator;
+	};
 	class Text {
 	public:
 		enum class HorizontalJustification {
@@ -108,7 +252,11 @@ public:
 			bottom
 		};
 
-		Text() {
+		typedef JGraph::allocator_type allocator_type;
+
+		Text() : Text(allocator_type()) {
+		}
+		explicit Text(const allocator_type& alloc) : content(alloc) {
 			position.x = NAN;
 			position.y = NAN;
 			font = "";
@@ -117,10 +265,15 @@ public:
 			rotate_angle = NAN;
 			hor_just = HorizontalJustification::Default;
 			ver_just = VerticalJustification::Default;
-			content = "";
+		}
+		Text(const Text& other, const allocator_type& alloc) : content(other.content, alloc) {
+			copySettings(other);
+		}
+		Text(Text&& other, const allocator_type& alloc) : content(move(other.content), alloc) {
+			copySettings(other);
 		}
 
-		string content;
+		pmr::string content;
 		Point<float> position;
 		string font;
 		float size;
@@ -130,6 +283,18 @@ public:
 		float rotate_angle;
 		Color color;
 
+		// Everything but content
+		void copySettings(const Text& other) {
+			position = other.position;
+			font = other.font;
+			size = other.size;
+			line_spacing = other.line_spacing;
+			hor_just = other.hor_just;
+			ver_just = other.ver_just;
+			rotate_angle = other.rotate_angle;
+			color = other.color;
+		}
+
 		bool empty() {
 			if (!isnan(position.x)) {
 				return false;
@@ -512,6 +677,35 @@ public:
 			}
 		}
 	};
+	// Where a curve writes its attributes (everything after its points). When
+	// recording, the start of each attribute's text is kept too, so a curve can
+	// be compared with the one before it (see Graph::copy_curves). An attribute
+	// is replaceable if writing it again fully overrides the earlier value.
+	class AttributeOut {
+	public:
+		struct Key {
+			const char* name;
+			size_t start;
+			bool replaceable;
+		};
+
+		AttributeOut(ostream& out, vector<Key>* keys = NULL) : out(out) {
+			this->keys = keys;
+		}
+
+		// Start attribute name, returning the stream to write it to
+		ostream& operator()(const char* name, bool replaceable = true) {
+			if (keys) keys->push_back({ name, (size_t)out.tellp(), replaceable });
+			return out;
+		}
+
+		ostream& out;
+	private:
+		vector<Key>* keys;
+	};
+
+	// Settings every mark type has. Marks are plain values, held by a Curve
+	// in an AnyMark (see below)
 	class Mark {
 	public:
 		Size<float> size;
@@ -522,10 +716,6 @@ public:
 			size.height = NAN;
 			rotate_angle = NAN;
 		}
-
-		virtual Mark* Clone() = 0;
-
-		virtual void toJGraph(ostream& out) = 0;
 	};
 	class ShapeMark : public Mark {
 	private:
@@ -587,70 +777,78 @@ public:
 			//mark_rotate_angle = NAN;
 		}
 
-		ShapeMark* Clone()
-		{
-			return new ShapeMark(*this);
+		void toJGraph(ostream& out) {
+			AttributeOut attributes(out);
+			toJGraph(attributes);
 		}
-
-		virtual void toJGraph(ostream& out) {
+		void toJGraph(AttributeOut& out) {
 			if (type == Type::none) {
-				out << "marktype none ";
+				out("marktype") << "marktype none ";
 				return;
 			}
 
 			if (type != Type::Default) {
 				string markType = shapeTypeToString();
-				out << "marktype " << markType << " ";
+				out("marktype") << "marktype " << markType << " ";
 			}
 			// Mark size
-			if (!(isnan(size.width) || isnan(size.height))) out << "marksize " << size.width << " " << size.height << " ";
+			if (!(isnan(size.width) || isnan(size.height))) out("marksize") << "marksize " << size.width << " " << size.height << " ";
 
 			// Mark Rotation
-			if (!(isnan(rotate_angle))) out << "mrotate " << rotate_angle << " ";
+			if (!(isnan(rotate_angle))) out("mrotate") << "mrotate " << rotate_angle << " ";
 
 			// Mark shape color fill
-			if (!(color.empty())) out << "cfill " << color.R << " " << color.G << " " << color.B << " ";
+			if (!(color.empty())) out("cfill") << "cfill " << color.R << " " << color.G << " " << color.B << " ";
 
 			// Mark Patterns
 			if (pattern != FillPattern::Default) {
-				out << "pattern " << fillPatternToString() << " " << fill_rotate_angle << " ";
+				out("pattern") << "pattern " << fillPatternToString() << " " << fill_rotate_angle << " ";
 			}
 
 		}
 	};
 	class TextMark : public Mark {
 	public:
-		Text text;
+		typedef JGraph::allocator_type allocator_type;
 
-		TextMark* Clone()
-		{
-			return new TextMark(*this);
+		TextMark() {
+		}
+		explicit TextMark(const allocator_type& alloc) : text(alloc) {
+		}
+		TextMark(const TextMark& other, const allocator_type& alloc) : Mark(other), text(other.text, alloc) {
+		}
+		TextMark(TextMark&& other, const allocator_type& alloc) : Mark(other), text(move(other.text), alloc) {
 		}
 
-		virtual void toJGraph(ostream& out) {
-			out << "marktype text ";
-			text.toJGraph(out);
-			out << endl;
+		Text text;
+
+		void toJGraph(ostream& out) {
+			AttributeOut attributes(out);
+			toJGraph(attributes);
+		}
+		void toJGraph(AttributeOut& out) {
+			out("marktype", false) << "marktype text ";
+			text.toJGraph(out.out);
+			out.out << endl;
 		}
 	};
 	class PostscriptRawMark : public Mark {
 	public:
 		string script;
 
-		PostscriptRawMark* Clone()
-		{
-			return new PostscriptRawMark(*this);
+		void toJGraph(ostream& out) {
+			AttributeOut attributes(out);
+			toJGraph(attributes);
 		}
-
-		virtual void toJGraph(ostream& out) {
-			out << "postscript : ";
-			out << script << " ";
+		void toJGraph(AttributeOut& out) {
+			out("marktype", false) << "postscript : ";
+			out.out << script << " ";
 
 			// Mark size
-			if (!(isnan(size.width) || isnan(size.height))) out << "marksize " << size.width << " " << size.height;
+			if (!(isnan(size.width) || isnan(size.height))) out("marksize", false) << "marksize " << size.width << " " << size.height;
 
 			// Mark Rotation
-			if (!(isnan(rotate_angle))) out << "mrotate " << rotate_angle << " ";
+			if (!(isnan(rotate_angle))) out("mrotate", false) << "mrotate " << rotate_angle << " ";
 		}
 	};
 	class PostscriptFileMark : public Mark {
@@ -668,20 +866,19 @@ public:
 			encapsulated = eps;
 		}
 
-		PostscriptFileMark* Clone()
-		{
-			return new PostscriptFileMark(*this);
+		void toJGraph(ostream& out) {
+			AttributeOut attributes(out);
+			toJGraph(attributes);
 		}
-
-		virtual void toJGraph(ostream& out) {
+		void toJGraph(AttributeOut& out) {
 			// postscript for encapsulated/files
-			out << ((encapsulated) ? "eps " : "postscript ") << fileName << " ";
+			out("marktype", false) << ((encapsulated) ? "eps " : "postscript ") << fileName << " ";
 
 			// Mark size
-			if (!(isnan(size.width) || isnan(size.height))) out << "marksize " << size.width << " " << size.height;
+			if (!(isnan(size.width) || isnan(size.height))) out("marksize", false) << "marksize " << size.width << " " << size.height;
 
 			// Mark Rotation
-			if (!(isnan(rotate_angle))) out << "mrotate " << rotate_angle << " ";
+			if (!(isnan(rotate_angle))) out("mrotate", false) << "mrotate " << rotate_angle << " ";
 		}
 	};
 	class GeneralMark : public Mark {
@@ -725,50 +922,82 @@ public:
 		Type type;
 		float fill_rotate_angle;
 
-		GeneralMark() {
+		typedef JGraph::allocator_type allocator_type;
+
+		GeneralMark() : GeneralMark(allocator_type()) {
+		}
+		explicit GeneralMark(const allocator_type& alloc) : points(alloc) {
 			pattern = FillPattern::Default;
 			type = Type::general;
 			fill_rotate_angle = 0;
 		}
-
-		GeneralMark* Clone()
-		{
-			return new GeneralMark(*this);
+		GeneralMark(const GeneralMark& other, const allocator_type& alloc) : Mark(other), points(other.points, alloc) {
+			color = other.color;
+			pattern = other.pattern;
+			type = other.type;
+			fill_rotate_angle = other.fill_rotate_angle;
+		}
+		GeneralMark(GeneralMark&& other, const allocator_type& alloc) : Mark(other), points(move(other.points), alloc) {
+			color = other.color;
+			pattern = other.pattern;
+			type = other.type;
+			fill_rotate_angle = other.fill_rotate_angle;
 		}
 
-		vector<Point<float>> points; // probably implement some checking on this, either in the constructor or in toJGraph; must be 3n+1 for bezier curves
+		pmr::vector<Point<float>> points; // probably implement some checking on this, either in the constructor or in toJGraph; must be 3n+1 for bezier curves
 
-		virtual void toJGraph(ostream& out) {
+		void toJGraph(ostream& out) {
+			AttributeOut attributes(out);
+			toJGraph(attributes);
+		}
+		void toJGraph(AttributeOut& out) {
 			// Check if bezier points number is valid
 			if ((points.size() % 3) != 1 && (type == Type::general_bez || type == Type::general_bez_nf)) return;
 
-			// Print points
-			out << "gmarks ";
+			// Print points, which jgraph adds to any it already has
+			out("gmarks", false) << "gmarks ";
 			for (int i = 0; i < points.size(); i++) {
-				out << points[i].x << " " << points[i].y << " ";
+				out.out << points[i].x << " " << points[i].y << " ";
 			}
 
 			// Marktype
-			out << "marktype " << typeToString() << " ";
+			out("marktype") << "marktype " << typeToString() << " ";
 
 			// If fill, specify fill information
 			if (type == Type::general || type == Type::general_bez) {
 				// Mark shape color fill
-				if (!(color.empty())) out << "cfill " << color.R << " " << color.G << " " << color.B << " ";
+				if (!(color.empty())) out("cfill") << "cfill " << color.R << " " << color.G << " " << color.B << " ";
 
 				// Mark Patterns
 				if (pattern != FillPattern::Default) {
-					out << "pattern " << fillPatternToString() << " " << fill_rotate_angle << " ";
+					out("pattern") << "pattern " << fillPatternToString() << " " << fill_rotate_angle << " ";
 				}
 			}
 
 			// Mark size
-			if (!(isnan(size.width) || isnan(size.height))) out << "marksize " << size.width << " " << size.height << " ";
+			if (!(isnan(size.width) || isnan(size.height))) out("marksize") << "marksize " << size.width << " " << size.height << " ";
 
 			// Mark Rotation
-			if (!(isnan(rotate_angle))) out << "mrotate " << rotate_angle << " ";
+			if (!(isnan(rotate_angle))) out("mrotate") << "mrotate " << rotate_angle << " ";
 		}
 	};
+	// One mark of any type, stored inline; monostate is a curve without marks
+	typedef variant<monostate, ShapeMark, TextMark, PostscriptRawMark, PostscriptFileMark, GeneralMark> AnyMark;
+
+	// Copy or move a mark into alloc's memory resource
+	template <typename M>
+	static AnyMark markWithAllocator(M&& mark, const allocator_type& alloc) {
+		return visit([&](auto&& m) -> AnyMark {
+			typedef decay_t<decltype(m)> T;
+			if constexpr (uses_allocator<T, allocator_type>::value) {
+				return AnyMark(in_place_type<T>, forward<decltype(m)>(m), alloc);
+			}
+			else {
+				return AnyMark(in_place_type<T>, forward<decltype(m)>(m));
+			}
+		}, forward<M>(mark));
+	}
+
 	class Arrows {
 	private:
 		inline string fillPatternToString() {
@@ -882,6 +1111,163 @@ public:
 			default: return "";
 			}
 		}
+
+		// Everything but the containers, marks and label
+		void copySettings(const Curve& other) {
+			curve = other.curve;
+			polyFillColor = other.polyFillColor;
+			polyFill = other.polyFill;
+			poly_rotate_angle = other.poly_rotate_angle;
+			curveColor = other.curveColor;
+			lineType = other.lineType;
+			lineThickness = other.lineThickness;
+			clip = other.clip;
+			arrows = other.arrows;
+			decimation = other.decimation;
+			pointSource = other.pointSource;
+		}
+
+		// Maps x to one of the pixel columns across the x axis, over the axis
+		// min and max or, where they aren't set, the range of the points
+		class Columns {
+		public:
+			template <typename Points>
+			Columns(const Points& source, const Axis* xaxis) {
+				float inches = (xaxis && !isnan(xaxis->size_inches)) ? xaxis->size_inches : DEFAULT_AXIS_INCHES;
+				count = max(1, (int)(inches * RENDER_DENSITY));
+				logScale = xaxis && xaxis->scale == Axis::Scale::log;
+				low = INFINITY;
+				high = -INFINITY;
+				for (size_t i = 0; i < source.size(); i++) {
+					double x = scaled(source[i].x);
+					if (x < low) low = x;
+					if (x > high) high = x;
+				}
+				if (xaxis && !isnan(xaxis->min)) low = scaled(xaxis->min);
+				if (xaxis && !isnan(xaxis->max)) high = scaled(xaxis->max);
+			}
+
+			int count;
+
+			int of(float x) const {
+				if (!(high > low)) return 0;
+				double column = (scaled(x) - low) / (high - low) * count;
+				if (!(column >= 0)) return 0;
+				if (column >= count) return count - 1;
+				return (int)column;
+			}
+		private:
+			double scaled(float x) const {
+				return logScale ? log10((double)x) : x;
+			}
+
+			bool logScale;
+			double low;
+			double high;
+		};
+
+		// Thinned points, false if the curve isn't thinned or has few enough
+		// points to write them all
+		template <typename Points>
+		bool decimatedToJGraph(ostream& out, const Points& source, const Axis* xaxis) {
+			if (decimation == Decimation::none || curve == CurveType::bezier) return false;
+			Columns columns(source, xaxis);
+			if (decimation == Decimation::minMax && source.size() > 4 * columns.count) {
+				minMaxToJGraph(out, source, columns);
+				return true;
+			}
+			if (decimation == Decimation::lttb && source.size() > 2 * columns.count) {
+				lttbToJGraph(out, source, 2 * columns.count);
+				return true;
+			}
+			return false;
+		}
+
+		static void pointToJGraph(ostream& out, const Point<float>& point) {
+			out << point.x << " " << point.y << " ";
+		}
+
+		// Every point, or the thinned ones if the curve decimates
+		template <typename Points>
+		void pointsToJGraph(ostream& out, const Points& source, const Axis* xaxis) {
+			if (!decimatedToJGraph(out, source, xaxis)) {
+				for (size_t i = 0; i < source.size(); i++) {
+					pointToJGraph(out, source[i]);
+				}
+			}
+		}
+
+		// For each run of points in the same pixel column, the first, lowest,
+		// highest and last of them in their original order (M4). Lines drawn
+		// through these cover the same pixels as lines through every point.
+		template <typename Points>
+		void minMaxToJGraph(ostream& out, const Points& source, const Columns& columns) {
+			size_t begin = 0;
+			while (begin < source.size()) {
+				int column = columns.of(source[begin].x);
+				size_t end = begin + 1;
+				size_t lowest = begin;
+				size_t highest = begin;
+				while (end < source.size() && columns.of(source[end].x) == column) {
+					if (source[end].y < source[lowest].y) lowest = end;
+					if (source[end].y > source[highest].y) highest = end;
+					end++;
+				}
+
+				size_t picked[4] = { begin, min(lowest, highest), max(lowest, highest), end - 1 };
+				for (int k = 0; k < 4; k++) {
+					if (k == 0 || picked[k] != picked[k - 1]) pointToJGraph(out, source[picked[k]]);
+				}
+				begin = end;
+			}
+		}
+
+		// Largest-triangle-three-buckets: keeps the first and last points and,
+		// from each of kept - 2 equal buckets in between, the point making the
+		// largest triangle with the last kept point and the next bucket's average.
+		// Points need to be in x order.
+		template <typename Points>
+		void lttbToJGraph(ostream& out, const Points& source, int kept) {
+			size_t n = source.size();
+			double bucket = (double)(n - 2) / (kept - 2);
+			size_t previous = 0;
+			pointToJGraph(out, source[0]);
+			for (int b = 0; b < kept - 2; b++) {
+				size_t begin = (size_t)(b * bucket) + 1;
+				size_t end = (size_t)((b + 1) * bucket) + 1;
+				size_t nextEnd = min((size_t)((b + 2) * bucket) + 1, n);
+
+				double averageX = 0;
+				double averageY = 0;
+				for (size_t i = end; i < nextEnd; i++) {
+					averageX += source[i].x;
+					averageY += source[i].y;
+				}
+				if (nextEnd > end) {
+					averageX /= nextEnd - end;
+					averageY /= nextEnd - end;
+				}
+				else {
+					averageX = source[n - 1].x;
+					averageY = source[n - 1].y;
+				}
+
+				double ax = source[previous].x;
+				double ay = source[previous].y;
+				double largest = -1;
+				size_t picked = begin;
+				for (size_t i = begin; i < end; i++) {
+					double area = fabs((ax - averageX) * (source[i].y - ay) - (ax - source[i].x) * (averageY - ay));
+					if (area > largest) {
+						largest = area;
+						picked = i;
+					}
+				}
+				pointToJGraph(out, source[picked]);
+				previous = picked;
+			}
+			pointToJGraph(out, source[n - 1]);
+		}
 	public:
 		enum class LineType {
 			linesolid,
@@ -908,58 +1294,111 @@ public:
 			none
 		};
 
-		vector<Point<float> > points;
-		vector<ErrorPoint<float> > x_error_points;
-		vector<ErrorPoint<float> > y_error_points;
+		// Thinning of large point sets as they are written, sized to the pixel
+		// columns the x axis takes up at RENDER_DENSITY. Meant for line plots:
+		// marks that aren't kept are not drawn. Bezier curves are never thinned.
+		enum class Decimation {
+			none,
+			minMax, // First, lowest, highest and last point of each column, for any point order
+			lttb // Largest-triangle-three-buckets down to 2 points per column, for points in x order
+		};
+
+		pmr::vector<Point<float> > points;
+		// Written instead of points when set
+		PointSource pointSource;
+		pmr::vector<ErrorPoint<float> > x_error_points;
+		pmr::vector<ErrorPoint<float> > y_error_points;
 
 		CurveType curve;
 		Color polyFillColor;
 		FillPattern polyFill;
 		float poly_rotate_angle;
 
-		vector<Point<float>> glines;
+		pmr::vector<Point<float>> glines;
 
 		Color curveColor;
 		LineType lineType;
 		float lineThickness;
-		unique_ptr<Mark> marks;
+		AnyMark marks;
 		bool clip;
 		Text label;
 		Arrows arrows;
+		Decimation decimation;
 
-		Curve() {
+		typedef JGraph::allocator_type allocator_type;
+
+		Curve() : Curve(allocator_type()) {
+		}
+		explicit Curve(const allocator_type& alloc)
+			: points(alloc), x_error_points(alloc), y_error_points(alloc), glines(alloc), label(alloc) {
 			curve = CurveType::none;
 			lineType = LineType::linesolid;
 			lineThickness = NAN;
 			clip = false;
 			poly_rotate_angle = 0;
 			polyFill = FillPattern::Default;
+			decimation = Decimation::none;
 		}
-		Curve(const Curve& other) : marks((other.marks) ? (other.marks->Clone()) : (NULL)) {
-			points = other.points;
-			x_error_points = other.x_error_points;
-			y_error_points = other.y_error_points;
-			curve = other.curve;
-			polyFillColor = other.polyFillColor;
-			polyFill = other.polyFill;
-			poly_rotate_angle = other.poly_rotate_angle;
-			glines = other.glines;
-			curveColor = other.curveColor;
-			lineType = other.lineType;
-			lineThickness = other.lineThickness;
-			clip = other.clip;
-			label = other.label;
-			arrows = other.arrows;
+		Curve(const Curve& other, const allocator_type& alloc)
+			: points(other.points, alloc), x_error_points(other.x_error_points, alloc), y_error_points(other.y_error_points, alloc),
+			glines(other.glines, alloc), marks(markWithAllocator(other.marks, alloc)), label(other.label, alloc) {
+			copySettings(other);
+		}
+		Curve(Curve&& other, const allocator_type& alloc)
+			: points(move(other.points), alloc), x_error_points(move(other.x_error_points), alloc),
+			y_error_points(move(other.y_error_points), alloc), glines(move(other.glines), alloc),
+			marks(markWithAllocator(move(other.marks), alloc)), label(move(other.label), alloc) {
+			copySettings(other);
+		}
+		Curve(const Curve& other) = default;
+		Curve(Curve&& other) = default;
+		Curve& operator=(const Curve& other) = default;
+		Curve& operator=(Curve&& other) = default;
+
+		allocator_type get_allocator() const {
+			return points.get_allocator();
+		}
+
+		// Give the curve a new T mark, using the curve's memory resource. The
+		// pointer is good until the curve is moved or given another mark.
+		template <typename T>
+		T* makeMark() {
+			if constexpr (uses_allocator<T, allocator_type>::value) {
+				return &marks.template emplace<T>(get_allocator());
+			}
+			else {
+				return &marks.template emplace<T>();
+			}
+		}
+		// Number of points written, from pointSource if it is set
+		size_t pointCount() const {
+			return pointSource.empty() ? points.size() : pointSource.size();
+		}
+		// Bezier curves need 3n+1 points, otherwise the curve is left out
+		bool valid() {
+			return !(curve == CurveType::bezier && (pointCount() % 3) != 1);
 		}
-		void toJGraph(ostream& out) {
-			if (curve == CurveType::bezier && (points.size() % 3) != 1) return;
+
+		// xaxis is the axis of the graph the curve is in, for decimation
+		void toJGraph(ostream& out, const Axis* xaxis = NULL) {
+			if (!valid()) return;
 
 			out << "newcurve ";
+			pointsToJGraph(out, xaxis);
+			AttributeOut attributes(out);
+			attributesToJGraph(attributes);
+			out << endl;
+		}
 
+		// Points and error points
+		void pointsToJGraph(ostream& out, const Axis* xaxis = NULL) {
 			// Curve points
 			out << "pts ";
-			for (int i = 0; i < points.size(); i++) {
-				out << points[i].x << " " << points[i].y << " ";
+			if (pointSource.empty()) {
+				pointsToJGraph(out, points, xaxis);
+			}
+			else {
+				pointSource.visit([&](const auto& source) { pointsToJGraph(out, source, xaxis); });
 			}
 
 			// Error Points
@@ -979,50 +1418,53 @@ public:
 						<< y_error_points[i].high << " ";
 				}
 			}
+		}
 
-
+		// Everything after the points
+		void attributesToJGraph(AttributeOut& out) {
 			// Marks
-			marks->toJGraph(out);
+			visit([&](auto& m) {
+				if constexpr (!is_same<decay_t<decltype(m)>, monostate>::value) m.toJGraph(out);
+			}, marks);
 
 			// Linetype
-			out << "linetype " << lineTypeToString() << " ";
+			out("linetype", lineType != LineType::general) << "linetype " << lineTypeToString() << " ";
 			if (lineType == LineType::general) {
 				for (int i = 0; i < glines.size(); i++) {
-					out << glines[i].x << " " << glines[i].y << " ";
+					out.out << glines[i].x << " " << glines[i].y << " ";
 				}
 			}
-			if (!(isnan(lineThickness))) out << "linethickness " << lineThickness << endl;
+			if (!(isnan(lineThickness))) out("linethickness") << "linethickness " << lineThickness << endl;
 
 			// Arrows
-			arrows.toJGraph(out);
+			arrows.toJGraph(out("arrows", false));
 
 
 			// If poly, it has extra parameters
 			if (curve == CurveType::poly) {
-				out << "poly ";
+				out("poly", false) << "poly ";
 
 				// Poly color
-				if (!(polyFillColor.empty())) out << "pcfill " << polyFillColor.R << " " << polyFillColor.G << " " << polyFillColor.B << " ";
+				if (!(polyFillColor.empty())) out.out << "pcfill " << polyFillColor.R << " " << polyFillColor.G << " " << polyFillColor.B << " ";
 
 				// Poly pattern
 				if (polyFill != FillPattern::Default) {
-					out << "pattern " << fillPatternToString() << " " << poly_rotate_angle << " ";
+					out.out << "pattern " << fillPatternToString() << " " << poly_rotate_angle << " ";
 				}
 			}
 			else if (curve == CurveType::bezier) {
-				out << "bezier ";
+				out("bezier") << "bezier ";
 			}
 
 			// Color
-			if (!(curveColor.empty())) out << "color " << curveColor.R << " " << curveColor.G << " " << curveColor.B << " ";
+			if (!(curveColor.empty())) out("color") << "color " << curveColor.R << " " << curveColor.G << " " << curveColor.B << " ";
 
 			// Clip
-			if (clip) out << "clip ";
-			else out << "noclip ";
+			if (clip) out("clip") << "clip ";
+			else out("clip") << "noclip ";
 
 			// Label
-			label.toJGraph(out);
-			out << endl;
+			label.toJGraph(out("label", false));
 		}
 
 	};
@@ -1071,24 +1513,101 @@ public:
 
 	class Graph {
 	public:
-		Graph() {
+		typedef JGraph::allocator_type allocator_type;
+
+		Graph() : Graph(allocator_type()) {
+		}
+		explicit Graph(const allocator_type& alloc) : curves(alloc), strings(alloc), title(alloc) {
 			border = false;
 			clip = false;
+			copy_curves = false;
+			x_translate = NAN;
+			y_translate = NAN;
+		}
+		Graph(const Graph& other, const allocator_type& alloc)
+			: xaxis(other.xaxis), yaxis(other.yaxis), curves(other.curves, alloc), strings(other.strings, alloc),
+			legend(other.legend), title(other.title, alloc) {
+			border = other.border;
+			clip = other.clip;
+			copy_curves = other.copy_curves;
+			x_translate = other.x_translate;
+			y_translate = other.y_translate;
+		}
+		Graph(Graph&& other, const allocator_type& alloc)
+			: xaxis(move(other.xaxis)), yaxis(move(other.yaxis)), curves(move(other.curves), alloc),
+			strings(move(other.strings), alloc), legend(move(other.legend)), title(move(other.title), alloc) {
+			border = other.border;
+			clip = other.clip;
+			copy_curves = other.copy_curves;
+			x_translate = other.x_translate;
+			y_translate = other.y_translate;
+		}
+
+		allocator_type get_allocator() const {
+			return curves.get_allocator();
 		}
+
 		Axis xaxis;
 		Axis yaxis;
-		vector<Curve> curves;
-		vector<Text> strings;
+		pmr::vector<Curve> curves;
+		pmr::vector<Text> strings;
 		Legend legend;
 		Text title;
 		bool border;
 		bool clip;
-		//float x_translate;
-		//float y_translate;
+		// Write a curve that only changes some attributes of the one before it
+		// as copycurve plus those attributes, instead of repeating all of them
+		bool copy_curves;
+		// Where the graph is drawn on the page, in inches from where it would be
+		float x_translate;
+		float y_translate;
 		//float X;
 		//float Y;
 
 		void toJGraph(ostream& out) {
+			headerToJGraph(out);
+			if (copy_curves) {
+				copyCurvesToJGraph(out);
+			}
+			else {
+				curvesToJGraph(out, 0, curves.size());
+			}
+			footerToJGraph(out);
+		}
+
+		// The same script as toJGraph, split into tasks that can run at the
+		// same time and be joined in order: the placement and axes, runs of curves with at
+		// least TASK_POINTS points (or the rest), and the strings and legend.
+		// With copy_curves each curve depends on the last, so they are one task.
+		void toJGraphTasks(vector<ScriptTask>& tasks) {
+			tasks.push_back([this](ostream& out) { headerToJGraph(out); });
+			if (copy_curves) {
+				tasks.push_back([this](ostream& out) { copyCurvesToJGraph(out); });
+			}
+			else {
+				size_t first = 0;
+				size_t points = 0;
+				for (size_t i = 0; i < curves.size(); i++) {
+					points += curves[i].pointCount();
+					if (points >= TASK_POINTS || i + 1 == curves.size()) {
+						tasks.push_back([this, first, i](ostream& out) { curvesToJGraph(out, first, i + 1); });
+						first = i + 1;
+						points = 0;
+					}
+				}
+			}
+			tasks.push_back([this](ostream& out) { footerToJGraph(out); });
+		}
+
+	private:
+		// Placement, title and axes
+		void headerToJGraph(ostream& out) {
+			if (!isnan(x_translate)) {
+				out << "x_translate " << x_translate << endl;
+			}
+			if (!isnan(y_translate)) {
+				out << "y_translate " << y_translate << endl;
+			}
 			if (!title.empty()) {
 				out << "title ";
 				title.toJGraph(out);
@@ -1098,9 +1617,17 @@ public:
 			xaxis.toJGraph(out);
 			out << "yaxis\n";
 			yaxis.toJGraph(out);
-			for (int i = 0; i < curves.size(); i++) {
-				curves[i].toJGraph(out);
+		}
+
+		// Curves first up to (not including) last
+		void curvesToJGraph(ostream& out, size_t first, size_t last) {
+			for (size_t i = first; i < last; i++) {
+				curves[i].toJGraph(out, &xaxis);
 			}
+		}
+
+		// Strings, legend and graph options
+		void footerToJGraph(ostream& out) {
 			for (int i = 0; i < strings.size(); i++) {
 				strings[i].toJGraph(out);
 				out << endl;
@@ -1113,10 +1640,67 @@ public:
 				out << "noclip\n";
 			}
 		}
+
+		// The curves, each compared with the last one written: if both have the
+		// same attributes and the ones that changed can be overridden, the curve
+		// is written as copycurve with just those
+		void copyCurvesToJGraph(ostream& out) {
+			ostringstream text;
+			string written[2];
+			vector<AttributeOut::Key> keys[2];
+			int previous = -1;
+			for (int i = 0; i < curves.size(); i++) {
+				if (!curves[i].valid()) continue;
+				int current = (previous == 0) ? 1 : 0;
+				text.str("");
+				keys[current].clear();
+				AttributeOut attributes(text, &keys[current]);
+				curves[i].attributesToJGraph(attributes);
+
+				written[current] = text.str();
+				const string& now = written[current];
+				const string& before = written[(previous >= 0) ? previous : current];
+				vector<AttributeOut::Key>& nowKeys = keys[current];
+				bool copy = previous >= 0 && keys[previous].size() == nowKeys.size();
+				string changed;
+				for (int k = 0; copy && k < nowKeys.size(); k++) {
+					AttributeOut::Key& was = keys[previous][k];
+					if (strcmp(was.name, nowKeys[k].name) != 0) {
+						copy = false;
+						break;
+					}
+					size_t wasEnd = (k + 1 < nowKeys.size()) ? keys[previous][k + 1].start : before.size();
+					size_t nowEnd = (k + 1 < nowKeys.size()) ? nowKeys[k + 1].start : now.size();
+					if (before.compare(was.start, wasEnd - was.start, now, nowKeys[k].start, nowEnd - nowKeys[k].start) == 0) continue;
+					if (!nowKeys[k].replaceable) {
+						copy = false;
+						break;
+					}
+					changed.append(now, nowKeys[k].start, nowEnd - nowKeys[k].start);
+				}
+
+				if (copy) {
+					out << "copycurve ";
+					curves[i].pointsToJGraph(out, &xaxis);
+					out << changed << endl;
+				}
+				else {
+					out << "newcurve ";
+					curves[i].pointsToJGraph(out, &xaxis);
+					out << now << endl;
+				}
+				previous = current;
+			}
+		}
 	};
 	class Canvas {
 	public:
-		Canvas() {
+		typedef JGraph::allocator_type allocator_type;
+
+		Canvas() : Canvas(allocator_type()) {
+		}
+		explicit Canvas(const allocator_type& alloc) : graphs(alloc) {
+			serialize_threads = 1;
 			size.width = NAN;
 			size.height = NAN;
 			bounding_box.X = NAN;
@@ -1124,12 +1708,32 @@ public:
 			bounding_box.width = NAN;
 			bounding_box.height = NAN;
 		}
+		Canvas(const Canvas& other, const allocator_type& alloc)
+			: graphs(other.graphs, alloc), size(other.size), bounding_box(other.bounding_box),
+			preamble(other.preamble), epilogue(other.epilogue) {
+			serialize_threads = other.serialize_threads;
+		}
+		Canvas(Canvas&& other, const allocator_type& alloc)
+			: graphs(move(other.graphs), alloc), size(other.size), bounding_box(other.bounding_box),
+			preamble(move(other.preamble)), epilogue(move(other.epilogue)) {
+			serialize_threads = other.serialize_threads;
+		}
+
+		allocator_type get_allocator() const {
+			return graphs.get_allocator();
+		}
 
-		vector<Graph> graphs;
+		pmr::vector<Graph> graphs;
 		Size<float> size;
 		Rectangle<float> bounding_box;
 		string preamble;
 		string epilogue;
+		// Threads that format graphs and runs of large curves at the same time,
+		// each into its own buffer, while the calling thread writes the buffers
+		// out in order. The script is the same byte for byte as with 1, which
+		// formats everything on the calling thread. Point source generators
+		// get called from these threads.
+		unsigned serialize_threads;
 
 		void toJGraph(ostream& out) {
 			if (!preamble.empty()) {
@@ -1152,24 +1756,128 @@ public:
 					<< bounding_box.X + bounding_box.width << " " << bounding_box.Y + bounding_box.height
 					<< endl;
 			}
-			for (int i = 0; i < graphs.size(); i++) {
-				out << "newgraph\n";
-				graphs[i].toJGraph(out);
+			if (serialize_threads > 1) {
+				parallelGraphsToJGraph(out);
+			}
+			else {
+				for (int i = 0; i < graphs.size(); i++) {
+					out << "newgraph\n";
+					graphs[i].toJGraph(out);
+				}
 			}
 			
 		}
+
+	private:
+		// Every graph's tasks, formatted by serialize_threads workers and written
+		// to out in order as soon as each one and everything before it is done
+		void parallelGraphsToJGraph(ostream& out) {
+			vector<ScriptTask> tasks;
+			for (int i = 0; i < graphs.size(); i++) {
+				tasks.push_back([](ostream& out) { out << "newgraph\n"; });
+				graphs[i].toJGraphTasks(tasks);
+			}
+
+			// Buffers format numbers the way out does, but never throw or flush
+			// another stream from a worker
+			vector<ostringstream> buffers(tasks.size());
+			for (size_t i = 0; i < tasks.size(); i++) {
+				buffers[i].copyfmt(out);
+				buffers[i].exceptions(ios::goodbit);
+				buffers[i].tie(NULL);
+			}
+			vector<char> done(tasks.size(), 0);
+			mutex doneLock;
+			condition_variable doneChanged;
+			atomic<size_t> nextTask(0);
+
+			vector<thread> pool;
+			size_t workers = min((size_t)serialize_threads, tasks.size());
+			for (size_t w = 0; w < workers; w++) {
+				pool.push_back(thread([&]() {
+					for (size_t i = nextTask++; i < tasks.size(); i = nextTask++) {
+						tasks[i](buffers[i]);
+						lock_guard<mutex> lock(doneLock);
+						done[i] = 1;
+						doneChanged.notify_one();
+					}
+				}));
+			}
+
+			for (size_t i = 0; i < tasks.size(); i++) {
+				{
+					unique_lock<mutex> lock(doneLock);
+					doneChanged.wait(lock, [&]() { return done[i] != 0; });
+				}
+				string text = buffers[i].str();
+				out.write(text.data(), text.size());
+				buffers[i].str(string());
+			}
+			for (size_t w = 0; w < pool.size(); w++) {
+				pool[w].join();
+			}
+		}
 	};
 public:
-	static int jgraphToJPG(JGraph::Canvas& canvas, string filename, bool safe=true) {
+	// Render statuses returned by jgraphToJPG
+	enum RenderStatus {
+		RENDER_OK = 0, // Image was written
+		RENDER_FAILED = 1, // jgraph or convert could not start or exited with an error
+		RENDER_TIMEOUT = 2 // Deadline passed, jgraph and convert were killed
+	};
+
+	// Where the time of a render went, in nanoseconds
+	struct RenderTimes {
+		long serialize; // Canvas to script
+		long jgraph; // From starting jgraph until it exits
+		long convert; // From jgraph exiting until convert exits
+		chrono::steady_clock::time_point started; // When jgraph and convert were started
+		int jgraph_pid;
+		int convert_pid;
+	};
+
+	static int jgraphToJPG(JGraph::Canvas& canvas, string filename, bool safe=true, int deadline_ms=0, RenderTimes* times=NULL) {
+		if (times) *times = RenderTimes();
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		ostringstream script;
+		canvas.toJGraph(script);
+		if (times) times->serialize = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+		return jgraphToJPG(script.str(), filename, safe, deadline_ms, times);
+	}
+
+	static int jgraphToJPG(const string& script, string filename, bool safe=true, int deadline_ms=0, RenderTimes* times=NULL) {
+		// A render that fails before starting anything reports no time spent on it
+		if (times) {
+			times->jgraph = times->convert = 0;
+			times->started = chrono::steady_clock::time_point();
+			times->jgraph_pid = times->convert_pid = 0;
+		}
+		chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds(deadline_ms);
+
+		// When waiting, write to a temporary file and rename it over filename once
+		// convert succeeds, so a failed or late render leaves the last good image
+		string out_file = filename;
+		string out_arg = filename;
+		string density = to_string(RENDER_DENSITY);
+		size_t ext = filename.rfind('.');
+		if (safe && ext != string::npos && filename.find('/', ext) == string::npos) {
+			out_file = filename + ".part";
+			out_arg = filename.substr(ext + 1) + ":" + out_file;
+		}
+
 		Pipe jgraph_in_pipe;
 
 		Pipe jgraph_out_pipe;
 
+		chrono::steady_clock::time_point started = chrono::steady_clock::now();
+		chrono::steady_clock::time_point exited[2] = { started, started };
 		int jg_pid = fork();
 		if (!jg_pid) {
+			// Own process group, so a timeout can kill anything jgraph started
+			setpgid(0, 0);
 			if (!safe) {
 				if (fork()) {
-					exit(EXIT_SUCCESS);
+					_exit(EXIT_SUCCESS);
 				}
 			}
 			close(jgraph_in_pipe.input);
@@ -1177,20 +1885,24 @@ public:
 			dup2(jgraph_in_pipe.output, STDIN_FILENO);
 			dup2(jgraph_out_pipe.input, STDOUT_FILENO);
 			vector<const char*> args = { "jgraph", NULL };
-			if (execvp(args[0], (char* const*)&args[0])) {
-				throw system_error(errno, generic_category());
-			}
+			execvp(args[0], (char* const*)&args[0]);
+			_exit(127);
+		}
+		if (jg_pid > 0) {
+			setpgid(jg_pid, jg_pid);
 		}
 
 		close(jgraph_in_pipe.output);
 		close(jgraph_out_pipe.input);
 		Pipe image_out_pipe;
 
-		int gs_pid = fork();
+		int gs_pid = (jg_pid > 0) ? fork() : -1;
 		if (!gs_pid) {
+			// Own process group, so a timeout also kills convert's delegates (gs)
+			setpgid(0, 0);
 			if (!safe) {
 				if (fork()) {
-					exit(EXIT_SUCCESS);
+					_exit(EXIT_SUCCESS);
 				}
 			}
 			close(jgraph_in_pipe.input);
@@ -1200,11 +1912,12 @@ public:
 			// commented-out section below is for using ghost-script, which we cannot assume is installed
 			//string file_arg = "-sOutputFile=" + filename;
 			//vector<const char*> args = { "gs", "-q", "-sDEVICE=jpeg", "-r300","-dEPSCrop","-dBATCH","-dNOPAUSE", file_arg.c_str(), "-", NULL };
-			string file_arg = filename;
-			vector<const char*> args = { "convert", "-density", "300","-","-quality","100",file_arg.c_str(), NULL };
-			if (execvp(args[0], (char* const*)&args[0])) {
-				throw system_error(errno, generic_category());
-			}
+			vector<const char*> args = { "convert", "-density", density.c_str(),"-","-quality","100",out_arg.c_str(), NULL };
+			execvp(args[0], (char* const*)&args[0]);
+			_exit(127);
+		}
+		if (gs_pid > 0) {
+			setpgid(gs_pid, gs_pid);
 		}
 
 		close(jgraph_out_pipe.output);
@@ -1212,17 +1925,118 @@ public:
 
 		close(image_out_pipe.output);
 
-		__gnu_cxx::stdio_filebuf<char> jgraph_tobuf(jgraph_in_pipe.input, ios::out);
-		ostream jgout(&jgraph_tobuf);
+		if (jg_pid < 0 || gs_pid < 0) {
+			close(jgraph_in_pipe.input);
+			if (jg_pid > 0) waitpid(jg_pid, NULL, 0);
+			return RENDER_FAILED;
+		}
+
+		// A jgraph that dies early should be a failed render, not a SIGPIPE, so
+		// SIGPIPE is blocked on this thread while writing and one it raised is
+		// taken off again before unblocking. The rest of the process keeps
+		// whatever disposition it had.
+		sigset_t sigpipe_set, old_mask, pending;
+		sigemptyset(&sigpipe_set);
+		sigaddset(&sigpipe_set, SIGPIPE);
+		pthread_sigmask(SIG_BLOCK, &sigpipe_set, &old_mask);
+		sigpending(&pending);
+		bool sigpipe_was_pending = sigismember(&pending, SIGPIPE);
+
+		// Stream the script to jgraph, without blocking past the deadline
+		bool timed_out = false;
+		bool write_failed = false;
+		if (deadline_ms > 0) {
+			fcntl(jgraph_in_pipe.input, F_SETFL, O_NONBLOCK);
+		}
+		size_t written = 0;
+		while (written < script.size()) {
+			ssize_t n = write(jgraph_in_pipe.input, script.data() + written, script.size() - written);
+			if (n > 0) {
+				written += n;
+			}
+			else if (n < 0 && errno == EINTR) {
+				continue;
+			}
+			else if (n < 0 && errno == EAGAIN) {
+				long remaining = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+				if (remaining <= 0) {
+					timed_out = true;
+					break;
+				}
+				pollfd pfd = { jgraph_in_pipe.input, POLLOUT, 0 };
+				poll(&pfd, 1, (int)remaining);
+			}
+			else {
+				write_failed = true;
+				break;
+			}
+		}
+		close(jgraph_in_pipe.input);
+		sigpending(&pending);
+		if (!sigpipe_was_pending && sigismember(&pending, SIGPIPE)) {
+			timespec no_wait = { 0, 0 };
+			sigtimedwait(&sigpipe_set, NULL, &no_wait);
+		}
+		pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+
+		// Wait for both, polling so the deadline can be enforced
+		int pids[2] = { jg_pid, gs_pid };
+		int statuses[2] = { 0, 0 };
+		bool done[2] = { false, false };
+		while (!timed_out && !(done[0] && done[1])) {
+			for (int i = 0; i < 2; i++) {
+				if (done[i]) continue;
+				int r = waitpid(pids[i], &statuses[i], (deadline_ms > 0) ? WNOHANG : 0);
+				if (r == pids[i] || (r < 0 && errno != EINTR)) {
+					done[i] = true;
+					exited[i] = chrono::steady_clock::now();
+				}
+			}
+			if (done[0] && done[1]) break;
+			if (deadline_ms > 0) {
+				if (chrono::steady_clock::now() >= deadline) {
+					timed_out = true;
+					break;
+				}
+				usleep(1000);
+			}
+		}
+
+		for (int i = 0; i < 2; i++) {
+			if (!done[i]) exited[i] = chrono::steady_clock::now();
+		}
+		if (times) {
+			times->started = started;
+			times->jgraph_pid = jg_pid;
+			times->convert_pid = gs_pid;
+			times->jgraph = chrono::duration_cast<chrono::nanoseconds>(exited[0] - started).count();
+			times->convert = (exited[1] > exited[0]) ? chrono::duration_cast<chrono::nanoseconds>(exited[1] - exited[0]).count() : 0;
+		}
 
-		canvas.toJGraph(jgout);
+		if (timed_out) {
+			for (int i = 0; i < 2; i++) {
+				if (done[i]) continue;
+				kill(-pids[i], SIGKILL);
+				waitpid(pids[i], NULL, 0);
+			}
+			if (out_file != filename) unlink(out_file.c_str());
+			return RENDER_TIMEOUT;
+		}
 
-		jgraph_tobuf.close();
+		for (int i = 0; i < 2; i++) {
+			if (!WIFEXITED(statuses[i]) || WEXITSTATUS(statuses[i]) != 0) {
+				write_failed = true;
+			}
+		}
+		if (write_failed) {
+			if (out_file != filename) unlink(out_file.c_str());
+			return RENDER_FAILED;
+		}
 
-		int status;
-		waitpid(jg_pid, &status, 0);
-		waitpid(gs_pid, &status, 0);
-		return status;
+		if (out_file != filename && rename(out_file.c_str(), filename.c_str())) {
+			return RENDER_FAILED;
+		}
+		return RENDER_OK;
 	}
 };
 
@@ -0,0 +1,254 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <string>
+#include <ostream>
+#include <iomanip>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+using namespace std;
+
+/*
+ * Hardware performance counters (perf_event_open) around the engine
+ * kernels and the JGraph serializer. Opt in with perf().start(); if the
+ * kernel doesn't allow perf events (perf_event_paranoid, containers, VMs
+ * without a PMU) start() returns false, perf().error says why, and every
+ * PerfScope stays a no-op. Counters the CPU doesn't have are left out.
+ *
+ * Count a kernel with a PerfScope in scope:
+ *
+ *   PerfScope counters(PerfKernel::tileFall);
+ *
+ * Only the thread that called start() is counted. Reports give per-call
+ * averages of cycles, instructions, branch misses, L1 data cache read misses
+ * and last level cache misses.
+ */
+
+// Kernels that get counted
+enum class PerfKernel {
+	gameProcedure,
+	tileFall,
+	moveParse, // Move validation
+	serialize, // Canvas::toJGraph
+	COUNT
+};
+
+inline const char* perfKernelName(PerfKernel kernel) {
+	switch (kernel) {
+	case PerfKernel::gameProcedure: return "gameProcedure";
+	case PerfKernel::tileFall: return "tileFall";
+	case PerfKernel::moveParse: return "moveParse";
+	case PerfKernel::serialize: return "serialize";
+	default: return "";
+	}
+}
+
+class PerfCounters {
+public:
+	// The counters, in the order they are reported
+	enum Counter {
+		cycles,
+		instructions,
+		branch_misses,
+		l1d_misses,
+		llc_misses,
+		COUNTER_COUNT
+	};
+
+	static const char* counterName(int counter) {
+		switch (counter) {
+		case cycles: return "cycles";
+		case instructions: return "instructions";
+		case branch_misses: return "branch_misses";
+		case l1d_misses: return "l1d_misses";
+		case llc_misses: return "llc_misses";
+		default: return "";
+		}
+	}
+
+	struct Totals {
+		uint64_t calls;
+		uint64_t values[COUNTER_COUNT];
+	};
+
+	PerfCounters() {
+		enabled = false;
+		leader = -1;
+		for (int i = 0; i < COUNTER_COUNT; i++) {
+			fds[i] = -1;
+			slot[i] = -1;
+		}
+		slots = 0;
+		clear();
+	}
+
+	~PerfCounters() {
+		for (int i = 0; i < COUNTER_COUNT; i++) {
+			if (fds[i] >= 0) close(fds[i]);
+		}
+	}
+
+	bool enabled;
+	string error;
+	Totals totals[(int)PerfKernel::COUNT];
+
+	// Open the counters for the calling thread, false if perf events aren't allowed
+	bool start() {
+		if (enabled) return true;
+
+		// cycles leads the group, so every counter covers the same instructions
+		fds[cycles] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+		if (fds[cycles] < 0) {
+			error = string("perf_event_open: ") + strerror(errno);
+			return false;
+		}
+		leader = fds[cycles];
+		fds[instructions] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, leader);
+		fds[branch_misses] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, leader);
+		fds[l1d_misses] = open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+			| (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), leader);
+		fds[llc_misses] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, leader);
+
+		// Group reads return the counters that opened, in the order they opened
+		slots = 0;
+		for (int i = 0; i < COUNTER_COUNT; i++) {
+			slot[i] = (fds[i] >= 0) ? slots++ : -1;
+		}
+
+		ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+		enabled = true;
+		countingThread() = true;
+		return true;
+	}
+
+	void clear() {
+		memset(totals, 0, sizeof(totals));
+	}
+
+	// Current value of every counter, 0 for ones that didn't open
+	void read(uint64_t values[COUNTER_COUNT]) {
+		uint64_t buffer[1 + COUNTER_COUNT] = { 0 };
+		if (::read(leader, buffer, sizeof(buffer)) <= 0) {
+			buffer[0] = 0;
+		}
+		for (int i = 0; i < COUNTER_COUNT; i++) {
+			values[i] = (slot[i] >= 0 && slot[i] < (int)buffer[0]) ? buffer[1 + slot[i]] : 0;
+		}
+	}
+
+	void add(PerfKernel kernel, const uint64_t begin[COUNTER_COUNT], const uint64_t end[COUNTER_COUNT]) {
+		Totals& t = totals[(int)kernel];
+		t.calls++;
+		for (int i = 0; i < COUNTER_COUNT; i++) {
+			t.values[i] += end[i] - begin[i];
+		}
+	}
+
+	// Whether the calling thread is the one the counters count
+	static bool& countingThread() {
+		static thread_local bool counting = false;
+		return counting;
+	}
+
+	bool has(int counter) {
+		return slot[counter] >= 0;
+	}
+
+	// Per-call averages of every kernel that ran
+	void report(ostream& out) {
+		if (!enabled) {
+			out << "Hardware counters unavailable (" << error << ")" << endl;
+			return;
+		}
+		out << left << setw(15) << "kernel" << right << setw(8) << "calls";
+		for (int i = 0; i < COUNTER_COUNT; i++) {
+			out << setw(15) << counterName(i);
+		}
+		out << setw(8) << "IPC" << endl;
+		for (int k = 0; k < (int)PerfKernel::COUNT; k++) {
+			Totals& t = totals[k];
+			if (t.calls == 0) continue;
+			out << left << setw(15) << perfKernelName((PerfKernel)k) << right << setw(8) << t.calls << fixed << setprecision(1);
+			for (int i = 0; i < COUNTER_COUNT; i++) {
+				if (has(i)) out << setw(15) << (double)t.values[i] / t.calls;
+				else out << setw(15) << "-";
+			}
+			double ipc = t.values[cycles] ? (double)t.values[instructions] / t.values[cycles] : 0;
+			out << setw(8) << setprecision(2) << ipc << endl;
+		}
+		out.unsetf(ios::floatfield);
+		out << setprecision(6);
+	}
+
+	// Same averages as a JSON object keyed by kernel
+	void toJSON(ostream& out) {
+		out << "{";
+		bool first = true;
+		for (int k = 0; k < (int)PerfKernel::COUNT; k++) {
+			Totals& t = totals[k];
+			if (t.calls == 0) continue;
+			if (!first) out << ", ";
+			first = false;
+			out << "\"" << perfKernelName((PerfKernel)k) << "\": {\"calls\": " << t.calls;
+			for (int i = 0; i < COUNTER_COUNT; i++) {
+				if (has(i)) out << ", \"" << counterName(i) << "_per_call\": " << (double)t.values[i] / t.calls;
+			}
+			out << "}";
+		}
+		out << "}";
+	}
+
+private:
+	static int open(uint32_t type, uint64_t config, int group) {
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+		attr.read_format = PERF_FORMAT_GROUP;
+		attr.disabled = (group == -1) ? 1 : 0;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+	}
+
+	int fds[COUNTER_COUNT];
+	int slot[COUNTER_COUNT];
+	int slots;
+	int leader;
+};
+
+// The counters for this process
+inline PerfCounters& perf() {
+	static PerfCounters processCounters;
+	return processCounters;
+}
+
+// Counts its own scope as a call of kernel
+class PerfScope {
+public:
+	PerfScope(PerfKernel kernel) {
+		this->kernel = kernel;
+		active = perf().enabled && PerfCounters::countingThread();
+		if (active) perf().read(begin);
+	}
+	~PerfScope() {
+		if (!active) return;
+		uint64_t end[PerfCounters::COUNTER_COUNT];
+		perf().read(end);
+		perf().add(kernel, begin, end);
+	}
+private:
+	PerfKernel kernel;
+	bool active;
+	uint64_t begin[PerfCounters::COUNTER_COUNT];
+};
+
+#endif
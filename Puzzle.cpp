@@ -0,0 +1,438 @@
+/*
+-----------------------------
+Puzzle Game utilizing JGraph
+by Tyler Cultice
+-----------------------------
+
+The game being played, drawing it, replays and galleries. See Puzzle.h.
+*/
+
+#include "Puzzle.h"
+#include "Stats.h"
+#include "PerfCounters.h"
+#include <iostream>
+#include <algorithm>
+#include <sstream>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <list>
+#include <cmath>
+#include <dirent.h>
+
+int boardLen = BOARD_LEN;
+int boardHeight = BOARD_HEIGHT;
+
+GameEngine game;
+string file;
+
+int renderDeadline = 0;
+
+// Move drawn over the board in the next frame, cleared once drawn
+vector<JGraph::Point<int>> highlight;
+
+// Recently rendered frames, so a repeated board is served without jgraph
+struct CachedFrame {
+	string script;
+	string image;
+};
+list<CachedFrame> frameCache;
+#define FRAME_CACHE_SIZE 8
+
+// Memory for the canvas of the frame being drawn on each thread, reset after
+// every frame; a board canvas needs about 25KB
+#define FRAME_ARENA_SIZE (64 * 1024)
+
+// Space around a board in a gallery for its label and a margin, in inches
+#define GALLERY_MARGIN_WIDTH 1
+#define GALLERY_MARGIN_HEIGHT 2.5
+// Widest a gallery gets before its boards are drawn smaller, in inches
+#define GALLERY_WIDTH 24
+thread_local JGraph::Arena frameArena(FRAME_ARENA_SIZE);
+
+// Put the jgraph and convert processes of a render on the trace
+void traceRender(const JGraph::RenderTimes& times) {
+	if (!trace().enabled || !times.jgraph_pid) return;
+	int64_t started = trace().toNanos(times.started);
+	trace().child("jgraph", times.jgraph_pid, started, times.jgraph);
+	trace().child("convert", times.convert_pid, started, times.jgraph + times.convert);
+}
+
+// Render a canvas to fileName, within the render deadline if there is one
+int renderFrame(JGraph::Canvas& canvas, string fileName) {
+	// Same statuses as JGraph::jgraphToJPG
+	ostringstream scriptOut;
+	{
+		PhaseTimer timer(Phase::serialize);
+		PerfScope counters(PerfKernel::serialize);
+		canvas.toJGraph(scriptOut);
+	}
+	string script = scriptOut.str();
+
+	// Serve an identical frame from the cache
+	for (list<CachedFrame>::iterator it = frameCache.begin(); it != frameCache.end(); it++) {
+		if (it->script != script) continue;
+
+		string partName = fileName + ".part";
+		ofstream imageFile(partName, ios::trunc | ios::binary);
+		imageFile << it->image;
+		imageFile.close();
+		if (!imageFile || rename(partName.c_str(), fileName.c_str())) break;
+
+		frameCache.splice(frameCache.begin(), frameCache, it);
+		return JGraph::RENDER_OK;
+	}
+
+	JGraph::RenderTimes times{};
+	int status = JGraph::jgraphToJPG(script, fileName, true, renderDeadline, &times);
+	if (times.jgraph_pid) {
+		stats().record(Phase::jgraph, times.jgraph);
+		stats().record(Phase::convert, times.convert);
+	}
+	traceRender(times);
+	if (status != JGraph::RENDER_OK) return status;
+
+	// Remember it for next time
+	ifstream imageFile(fileName, ios::binary);
+	ostringstream image;
+	image << imageFile.rdbuf();
+	frameCache.push_front({ script, image.str() });
+	if (frameCache.size() > FRAME_CACHE_SIZE) frameCache.pop_back();
+
+	return status;
+}
+
+// Tell the player when a frame couldn't be rendered
+void renderError(int status) {
+	switch (status) {
+	case JGraph::RENDER_FAILED: cout << "Unable to render the board; is jgraph and convert installed?" << endl;
+		break;
+	case JGraph::RENDER_TIMEOUT: cout << "Rendering took too long; gameOutput.jpg still shows the last frame." << endl;
+		break;
+	default: break;
+	}
+}
+
+// Build the game over screen showing the final score
+JGraph::Canvas gameOverCanvas(long finalScore, JGraph::allocator_type alloc) {
+	// Canvas, contains graphs, set to boundaries required
+	JGraph::Canvas testcanvas(alloc);
+	testcanvas.bounding_box.X = 0;
+	testcanvas.bounding_box.Y = -3;
+	testcanvas.bounding_box.width = 6 * 72;
+	testcanvas.bounding_box.height = 5 * 72;
+	testcanvas.size.height = 4;
+	testcanvas.size.width = 6;
+	testcanvas.graphs.emplace_back();
+	JGraph::Graph& testgraph = testcanvas.graphs[0];
+
+	// X axis has no axis, only marks to build grid
+	JGraph::Axis& xaxis = testgraph.xaxis;
+	xaxis.size_inches = 6;
+	xaxis.min = 0;
+	xaxis.max = 9;
+	xaxis.hash_spacing = 1;
+	xaxis.minor_hash_count = 0;
+	xaxis.grid_lines = true;
+	xaxis.minor_grid_lines = false;
+	xaxis.mgrid_color = JGraph::Gray(.625);
+	xaxis.draw = false;
+
+	// Y axis has no axis, only marks to build grid
+	JGraph::Axis& yaxis = testgraph.yaxis;
+	yaxis.size_inches = 4;
+	yaxis.min = 0;
+	yaxis.max = 6;
+	yaxis.hash_spacing = 1;
+	yaxis.minor_hash_count = 0;
+	yaxis.grid_lines = true;
+	yaxis.minor_grid_lines = false;
+	yaxis.mgrid_color = JGraph::Gray(.625);
+	yaxis.draw = false;
+
+	// Black Background
+	testgraph.curves.emplace_back();
+	testgraph.curves[0].lineType = JGraph::Curve::LineType::none;
+	testgraph.curves[0].curveColor = JGraph::Color(0, 0, 0);
+	testgraph.curves[0].points = { {3,3} };
+	JGraph::ShapeMark* blackBackground = testgraph.curves.back().makeMark<JGraph::ShapeMark>();
+	blackBackground->type = JGraph::ShapeMark::Type::box;
+	blackBackground->size = { 50, 50 };
+	blackBackground->pattern = JGraph::ShapeMark::FillPattern::solid;
+	blackBackground->color = JGraph::Color(0, 0, 0);
+
+	// Score text
+	testgraph.curves.emplace_back();
+	JGraph::Curve& Scoretext = testgraph.curves.back();
+	Scoretext.lineType = JGraph::Curve::LineType::none;
+	Scoretext.points = { {4.5, 3} };
+	JGraph::TextMark* textMark = testgraph.curves.back().makeMark<JGraph::TextMark>();
+	textMark->text.font = "Arial";
+	textMark->text.size = 40;
+	textMark->text.color.R = 1;
+	textMark->text.color.G = 1;
+	textMark->text.color.B = 1;
+	textMark->text.line_spacing = 20;
+	textMark->text.content = "GAME OVER \n Score: ";
+	textMark->text.content += to_string(finalScore);
+
+	return testcanvas;
+}
+
+// If you run out of turns, finish game w/ Jgraph output and save file write
+void gameFinish(bool isSaved,string fileName) {
+	PhaseTimer timer(Phase::canvas);
+	JGraph::Canvas testcanvas = gameOverCanvas(game.score());
+	timer.stop();
+
+	// Time to terrify anyone by making it look like
+	// Their computer is compromised
+	// This looks that sketchy.
+	renderError(renderFrame(testcanvas, "gameOutput.jpg"));
+
+	// Rewrite the save file w/ score
+	ofstream saveFile(fileName, ios::trunc);
+	if (!saveFile.is_open())
+		return;
+
+	// Top game identifier
+	saveFile << "SAVE COMPLETE, GAME OVER" << endl
+		<< "SCORE: " << game.score() << endl;
+
+	saveFile.close();
+}
+
+// Draw the game being played using JGraph
+void drawBoard() {
+	{
+		PhaseTimer timer(Phase::canvas);
+		JGraph::Canvas testcanvas = game.canvas(frameArena.get());
+		if (!highlight.empty()) {
+			moveGraph(testcanvas.graphs[0], game.height(), highlight);
+			highlight.clear();
+		}
+		timer.stop();
+
+		// Convert to JPG
+		renderError(renderFrame(testcanvas, "gameOutput.jpg"));
+	}
+	frameArena.reset();
+}
+
+// Print why a move from validateMove was rejected
+void moveError(int status, int badMove) {
+	switch (status) {
+	case 1: cout << "Format of move is incorrect. Try again. " << endl;
+		break;
+	case 2: cout << "Move " << badMove << " not adjacent or already used. Cannot do move." << endl;
+		break;
+	case 3: cout << "Move " << badMove << " not same type. Cannot do move." << endl;
+		break;
+	case 4: cout << "Moves should be 3+ tiles." << endl;
+		break;
+	default: break;
+	}
+}
+
+// Run a command and wait for it, returns its exit status
+int runCommand(vector<string> command) {
+	vector<const char*> args;
+	for (int i = 0; i < command.size(); i++) {
+		args.push_back(command[i].c_str());
+	}
+	args.push_back(NULL);
+
+	int pid = fork();
+	if (!pid) {
+		execvp(args[0], (char* const*)&args[0]);
+		_exit(127);
+	}
+	if (pid < 0) return -1;
+
+	int status;
+	waitpid(pid, &status, 0);
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// Apply a file of moves (one per line) to the current game without drawing.
+// The moves are checked as if typed, so one that uses a tile twice stops the replay.
+int gameReplay(string movesName, vector<Frame>* frames) {
+	// 3 Statuses:
+	// 0 Replayed successfully
+	// 1 Unable to open the moves file
+	// 2 A recorded move is not valid
+	ifstream movesFile(movesName);
+	if (!movesFile.is_open())
+		return 1;
+
+	// Keep every turn's board if asked to
+	if (frames) frames->push_back({ game.board(), game.score(), game.turns() });
+
+	string playerMoves;
+	int lineNumber = 0;
+	while (game.turns() > 0 && getline(movesFile, playerMoves)) {
+		lineNumber++;
+		if (all_of(playerMoves.begin(), playerMoves.end(), ::isspace)) continue;
+
+		vector<JGraph::Point<int>> moves;
+		int badMove;
+		int moveStatus = game.validateMove(playerMoves, moves, badMove);
+		if (moveStatus != 0) {
+			cout << movesName << ":" << lineNumber << ": ";
+			moveError(moveStatus, badMove);
+			return 2;
+		}
+
+		game.applyMove(moves);
+		if (frames) frames->push_back({ game.board(), game.score(), game.turns() });
+	}
+
+	return 0;
+}
+
+// Replay a recorded game and render every turn on a pool of workers
+int gameExport(string saveName, string movesName, string outPrefix, unsigned workers, bool animate) {
+	// 4 Statuses:
+	// 0 Exported successfully
+	// 1 Unable to open the save or moves file
+	// 2 A recorded move is not valid
+	// 3 A frame could not be rendered
+	int status = game.load(saveName);
+	if (status == 2) return 2;
+	if (status == 1) game.newGame(boardLen, boardHeight);
+
+	// Rebuild every turn's board headlessly, only the engine runs here
+	vector<Frame> frames;
+	status = gameReplay(movesName, &frames);
+	if (status != 0) return status;
+
+	// Render the frames, each worker takes the next unrendered one
+	if (workers == 0) workers = max(1u, thread::hardware_concurrency());
+	workers = min(workers, (unsigned)frames.size());
+
+	vector<string> frameNames(frames.size());
+	for (int i = 0; i < frames.size(); i++) {
+		char number[16];
+		snprintf(number, sizeof(number), "_%03d.jpg", i);
+		frameNames[i] = outPrefix + number;
+	}
+
+	// Render status of each frame, each written by the worker that took it
+	vector<int> frameStatus(frames.size(), JGraph::RENDER_OK);
+
+	atomic<size_t> nextFrame(0);
+	vector<thread> pool;
+	for (unsigned w = 0; w < workers; w++) {
+		pool.push_back(thread([&]() {
+			for (size_t i = nextFrame++; i < frames.size(); i = nextFrame++) {
+				TraceScope frameScope("frame", i);
+
+				// Last frame of a finished game gets the game over screen
+				{
+					TraceScope canvasScope("canvas");
+					JGraph::Canvas canvas = (frames[i].numTurns == 0) ? gameOverCanvas(frames[i].score, frameArena.get())
+						: boardCanvas(frames[i].board, frames[i].score, frames[i].numTurns, frameArena.get());
+					canvasScope.stop();
+
+					JGraph::RenderTimes times{};
+					frameStatus[i] = JGraph::jgraphToJPG(canvas, frameNames[i], true, 0, &times);
+					traceRender(times);
+				}
+				frameArena.reset();
+			}
+		}));
+	}
+	for (int i = 0; i < pool.size(); i++) {
+		pool[i].join();
+	}
+
+	// Frames that weren't written would leave gaps, and nothing for the animation
+	int failed = 0;
+	for (int i = 0; i < frames.size(); i++) {
+		if (frameStatus[i] == JGraph::RENDER_OK) continue;
+		cout << "Unable to render " << frameNames[i] << "." << endl;
+		failed++;
+	}
+	if (failed) {
+		cout << failed << " of " << frames.size() << " frames could not be rendered";
+		if (animate) cout << ", " << outPrefix << ".gif was not created";
+		cout << "." << endl;
+		return 3;
+	}
+
+	cout << "Exported " << frames.size() << " frames to " << outPrefix << "_###.jpg" << endl;
+
+	// Stitch the frames into an animation
+	if (animate) {
+		vector<string> command = { "convert", "-delay", "100", "-loop", "0" };
+		command.insert(command.end(), frameNames.begin(), frameNames.end());
+		command.push_back(outPrefix + ".gif");
+		if (runCommand(command) != 0) {
+			cout << "Unable to create " << outPrefix << ".gif" << endl;
+		}
+	}
+
+	return 0;
+}
+
+// Draw every save in dirName as a grid of boards on one canvas, rendered to outName in one pass
+int gameGallery(string dirName, string outName) {
+	// 3 Statuses:
+	// 0 Drew the gallery (renderError says if the render failed)
+	// 1 Unable to open the directory
+	// 2 No valid saves in the directory
+	DIR* saves = opendir(dirName.c_str());
+	if (!saves) return 1;
+	vector<string> names;
+	for (dirent* entry = readdir(saves); entry; entry = readdir(saves)) {
+		string name = entry->d_name;
+		if (name[0] != '.') names.push_back(name);
+	}
+	closedir(saves);
+	sort(names.begin(), names.end());
+
+	// Every save that reads, with its file name
+	vector<Frame> frames;
+	vector<string> labels;
+	for (int i = 0; i < names.size(); i++) {
+		GameEngine save;
+		if (save.load(dirName + "/" + names[i]) != 0) {
+			cout << "Skipping " << names[i] << ", not a valid save." << endl;
+			continue;
+		}
+		frames.push_back({ save.board(), save.score(), save.turns() });
+		labels.push_back(names[i]);
+	}
+	if (frames.empty()) return 2;
+
+	// Square grid of cells that fit the largest board, drawn smaller when it
+	// would be wider than GALLERY_WIDTH
+	PhaseTimer timer(Phase::canvas);
+	int maxLen = 0, maxHeight = 0;
+	for (int i = 0; i < frames.size(); i++) {
+		maxLen = max(maxLen, (int)frames[i].board.size());
+		if (frames[i].board.size()) maxHeight = max(maxHeight, (int)frames[i].board[0].size());
+	}
+	float cellWidth = 6.0f * maxLen / BOARD_LEN + GALLERY_MARGIN_WIDTH;
+	float cellHeight = 4.0f * maxHeight / BOARD_HEIGHT + GALLERY_MARGIN_HEIGHT;
+	int columns = (int)ceil(sqrt((double)frames.size()));
+	float scale = min(1.0f, (float)GALLERY_WIDTH / (columns * cellWidth));
+	JGraph::Canvas gallery;
+	gallery.serialize_threads = max(1u, thread::hardware_concurrency());
+	gallery.graphs.reserve(frames.size());
+	for (int i = 0; i < frames.size(); i++) {
+		gallery.graphs.emplace_back();
+		JGraph::Graph& graph = gallery.graphs.back();
+		boardGraph(graph, frames[i].board, frames[i].score, frames[i].numTurns, scale);
+		graph.x_translate = (i % columns) * cellWidth * scale;
+		graph.y_translate = -(i / columns) * cellHeight * scale;
+		graph.title.content = labels[i].c_str();
+		graph.title.size = 16 * scale;
+	}
+	timer.stop();
+
+	renderError(renderFrame(gallery, outName));
+	cout << "Drew " << frames.size() << " boards to " << outName << endl;
+	return 0;
+}
@@ -0,0 +1,70 @@
+#ifndef PUZZLE_H
+#define PUZZLE_H
+
+#include "GameEngine.h"
+#include <vector>
+#include <string>
+
+using namespace std;
+
+/*
+ * The game as played from the command line: the game being played, drawing
+ * it, replays and galleries, and telling the player what went wrong. The
+ * rules are in GameEngine.h. Implemented in Puzzle.cpp.
+ */
+
+// Size of a new game, set with --size
+extern int boardLen;
+extern int boardHeight;
+
+// The game being played, and the file it is saved to
+extern GameEngine game;
+extern string file;
+
+// Longest a frame may take to render in ms, 0 waits as long as it takes
+extern int renderDeadline;
+
+// Move drawn over the board in the next frame (a hint), cleared once drawn
+extern vector<JGraph::Point<int>> highlight;
+
+// Snapshot of the game after a turn, used for replays
+struct Frame {
+	Board board;
+	long score;
+	int numTurns;
+};
+
+// Put the jgraph and convert processes of a render on the trace
+void traceRender(const JGraph::RenderTimes& times);
+
+// Render a canvas to fileName, within the render deadline if there is one
+int renderFrame(JGraph::Canvas& canvas, string fileName);
+
+// Tell the player when a frame couldn't be rendered
+void renderError(int status);
+
+// Build the game over screen showing the final score, allocating from alloc
+JGraph::Canvas gameOverCanvas(long finalScore, JGraph::allocator_type alloc = JGraph::allocator_type());
+
+// If you run out of turns, finish game w/ Jgraph output and save file write
+void gameFinish(bool isSaved, string fileName);
+
+// Draw the game being played using JGraph
+void drawBoard();
+
+// Print why a move from validateMove was rejected
+void moveError(int status, int badMove);
+
+// Run a command and wait for it, returns its exit status
+int runCommand(vector<string> command);
+
+// Apply a file of moves (one per line) to the current game without drawing
+int gameReplay(string movesName, vector<Frame>* frames);
+
+// Replay a recorded game and render every turn on a pool of workers
+int gameExport(string saveName, string movesName, string outPrefix, unsigned workers, bool animate);
+
+// Draw every save in dirName as a grid of boards on one canvas, rendered to outName in one pass
+int gameGallery(string dirName, string outName);
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include <string>
+
+using namespace std;
+
+/*
+ * Rule sets: how far tiles grow before they pop, which neighbours a pop
+ * grows, what a move scores, how many turns a game has and which tiles start
+ * blocked. Each rule set is a struct of compile-time constants, and the
+ * cascade, the score and a new game are instantiated for every one of them
+ * (alongside the board sizes specialized), so a variant runs code built
+ * for it. A game picks its rule set at run time:
+ *
+ *   game.setRules(RuleSet::diagonal);
+ *   game.newGame(9, 6);
+ *
+ * To add a rule set, derive it from ClassicRules overriding only what
+ * differs, then add it to RuleSet, ruleSetName and withRules.
+ */
+
+// The rules the game has always had
+struct ClassicRules {
+	// Size a growing tile pops at, 1 to 3 as saves hold sizes 0 to 2. Tiles
+	// already that big don't grow.
+	static constexpr int popSize = 3;
+
+	// Whether a pop grows the four diagonal neighbours too
+	static constexpr bool diagonalGrowth = false;
+
+	// Turns a new game starts with, and the most a save may have
+	static constexpr int turns = 10;
+
+	// Whether (x, y) starts blocked on a new len x height board
+	static constexpr bool blocked(int x, int y, int len, int height) {
+		return (x == 0 || x == len - 1) && (y == 0 || y == height - 1);
+	}
+
+	// Points for taking a tile of size in a move of moveTiles tiles
+	static constexpr int tileScore(int size, int moveTiles) {
+		return 10 * ((size + 1) * moveTiles) / 4;
+	}
+
+	// Points added to a move worth moveScore for the tiles popped, its own included
+	static constexpr int chainBonus(int moveScore, int popped) {
+		return moveScore * popped / 5;
+	}
+};
+
+// A pop grows all eight neighbours
+struct DiagonalRules : ClassicRules {
+	static constexpr bool diagonalGrowth = true;
+};
+
+// Nothing is blocked, and there are 15 turns
+struct OpenRules : ClassicRules {
+	static constexpr int turns = 15;
+
+	static constexpr bool blocked(int /*x*/, int /*y*/, int /*len*/, int /*height*/) {
+		return false;
+	}
+};
+
+// Tiles pop a size sooner, over 8 turns
+struct EagerRules : ClassicRules {
+	static constexpr int popSize = 2;
+	static constexpr int turns = 8;
+};
+
+// Every tile is worth 10 points whatever its size, and cascades twice as much
+struct FlatRules : ClassicRules {
+	static constexpr int tileScore(int /*size*/, int /*moveTiles*/) {
+		return 10;
+	}
+
+	static constexpr int chainBonus(int moveScore, int popped) {
+		return moveScore * popped * 2 / 5;
+	}
+};
+
+enum class RuleSet : unsigned char {
+	classic,
+	diagonal,
+	open,
+	eager,
+	flat,
+	COUNT
+};
+
+inline const char* ruleSetName(RuleSet rules) {
+	switch (rules) {
+	case RuleSet::classic: return "classic";
+	case RuleSet::diagonal: return "diagonal";
+	case RuleSet::open: return "open";
+	case RuleSet::eager: return "eager";
+	case RuleSet::flat: return "flat";
+	default: return "";
+	}
+}
+
+// Rule set called name, false if there is none
+inline bool parseRuleSet(string name, RuleSet& rules) {
+	for (int i = 0; i < (int)RuleSet::COUNT; i++) {
+		if (name == ruleSetName((RuleSet)i)) {
+			rules = (RuleSet)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Call f with a value of the type of rule set rules, returning what it does:
+// withRules(rules, [](auto r) { return decltype(r)::turns; })
+template <class F>
+auto withRules(RuleSet rules, F f) {
+	switch (rules) {
+	case RuleSet::diagonal: return f(DiagonalRules());
+	case RuleSet::open: return f(OpenRules());
+	case RuleSet::eager: return f(EagerRules());
+	case RuleSet::flat: return f(FlatRules());
+	default: return f(ClassicRules());
+	}
+}
+
+#endif
@@ -0,0 +1,762 @@
+#include "Search.h"
+#include "Stats.h"
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <pthread.h>
+
+// Starting tiles tried for the path through each group
+#define PATH_TRIES 3
+
+// Scratch space for candidateMoves, kept per thread so it doesn't allocate
+struct CandidateScratch {
+	vector<unsigned> seen; // Tiles put in a group by the call whose stamp they hold
+	unsigned stamp;
+	vector<char> onPath; // Tiles of the path being grown, all 0 between calls
+	vector<int> group;
+	Move path;
+	Move longest;
+};
+
+static thread_local CandidateScratch scratch;
+
+// Size the scratch space for a len x height board. On a large board that
+// takes longer than a search has, so a search does it before its budget starts.
+static void sizeScratch(int len, int height) {
+	if (scratch.seen.size() == (size_t)len * height) return;
+	scratch.seen.assign((size_t)len * height, 0);
+	scratch.onPath.assign((size_t)len * height, 0);
+	scratch.stamp = 0;
+}
+
+// Grow a path from start through tiles of its color, always stepping to the
+// neighbour with the fewest ways on so the path doesn't strand itself. Stops
+// at deadline once the path is long enough to be a move, true if it did.
+static bool growPath(const Board& board, int start, Move& path, chrono::steady_clock::time_point deadline) {
+	int len = board.size();
+	int height = board[0].size();
+	Tile::TileType type = board[start / height][start % height].type;
+
+	// Neighbours of (x, y) of the same color that aren't on the path yet
+	auto freeNeighbors = [&](int x, int y, auto visit) {
+		for (int nx = max(x - 1, 0); nx <= min(x + 1, len - 1); nx++) {
+			for (int ny = max(y - 1, 0); ny <= min(y + 1, height - 1); ny++) {
+				if (scratch.onPath[nx * height + ny] || board[nx][ny].type != type) continue;
+				visit(nx, ny);
+			}
+		}
+	};
+
+	path.clear();
+	int x = start / height;
+	int y = start % height;
+	bool expired = false;
+	while (true) {
+		path.push_back({ x, y });
+		scratch.onPath[x * height + y] = 1;
+		int bestX = -1;
+		int bestY = -1;
+		int fewest = 9;
+		freeNeighbors(x, y, [&](int nx, int ny) {
+			int onward = 0;
+			freeNeighbors(nx, ny, [&](int, int) { onward++; });
+			if (onward < fewest) {
+				fewest = onward;
+				bestX = nx;
+				bestY = ny;
+			}
+		});
+		if (bestX < 0) break;
+		if (path.size() >= GROUP_MIN_TILES && (path.size() == GROUP_MIN_TILES || path.size() % CLOCK_STRIDE == 0)
+			&& chrono::steady_clock::now() >= deadline) {
+			expired = true;
+			break;
+		}
+		x = bestX;
+		y = bestY;
+	}
+	for (int i = 0; i < path.size(); i++) {
+		scratch.onPath[path[i].x * height + path[i].y] = 0;
+	}
+	return expired;
+}
+
+// Moves worth trying on board, false if deadline came first
+bool candidateMoves(const Board& board, vector<Move>& out, chrono::steady_clock::time_point deadline) {
+	out.clear();
+	int len = board.size();
+	int height = len ? board[0].size() : 0;
+	// Clearing the marks of a large board would cost more than the search
+	// has, so they are only cleared when the stamp wraps around
+	sizeScratch(len, height);
+	if (++scratch.stamp == 0) {
+		scratch.seen.assign(len * height, 0);
+		scratch.stamp = 1;
+	}
+	unsigned stamp = scratch.stamp;
+
+	for (int cell = 0; cell < len * height; cell++) {
+		if (cell % CLOCK_STRIDE == 0 && chrono::steady_clock::now() >= deadline) return false;
+		Tile::TileType type = board[cell / height][cell % height].type;
+		if (scratch.seen[cell] == stamp || type == Tile::TileType::BLOCKED || type == Tile::TileType::empty) continue;
+
+		// Every tile of the group, and the one with the fewest neighbours in it
+		vector<int>& group = scratch.group;
+		group.clear();
+		group.push_back(cell);
+		scratch.seen[cell] = stamp;
+		// A group too big to go all over in time is cut short, a path from
+		// wherever its search got to is still a move
+		int end = cell;
+		int fewest = 9;
+		bool expired = false;
+		for (int i = 0; i < group.size(); i++) {
+			if (i % CLOCK_STRIDE == CLOCK_STRIDE - 1 && chrono::steady_clock::now() >= deadline) {
+				expired = true;
+				break;
+			}
+			int x = group[i] / height;
+			int y = group[i] % height;
+			int neighbors = 0;
+			for (int nx = max(x - 1, 0); nx <= min(x + 1, len - 1); nx++) {
+				for (int ny = max(y - 1, 0); ny <= min(y + 1, height - 1); ny++) {
+					if (board[nx][ny].type != type || (nx == x && ny == y)) continue;
+					neighbors++;
+					if (scratch.seen[nx * height + ny] == stamp) continue;
+					scratch.seen[nx * height + ny] = stamp;
+					group.push_back(nx * height + ny);
+				}
+			}
+			if (neighbors < fewest) {
+				fewest = neighbors;
+				end = group[i];
+			}
+		}
+		if (group.size() < GROUP_MIN_TILES) {
+			if (expired) return false;
+			continue;
+		}
+
+		// A path from an end of the group, then back from wherever it stopped
+		Move& longest = scratch.longest;
+		longest.clear();
+		int start = end;
+		for (int t = 0; t < PATH_TRIES && longest.size() < group.size(); t++) {
+			expired = growPath(board, start, scratch.path, deadline) || expired;
+			if (scratch.path.size() > longest.size()) longest.swap(scratch.path);
+			start = longest.back().x * height + longest.back().y;
+			if (expired) break;
+		}
+		if (longest.size() >= GROUP_MIN_TILES) {
+			out.push_back(longest);
+			if (longest.size() > GROUP_MIN_TILES) {
+				out.push_back(Move(longest.begin(), longest.begin() + GROUP_MIN_TILES));
+			}
+		}
+		if (expired) return false;
+	}
+	return true;
+}
+
+// One thread's copy of the game and where it is in the search. Each search
+// thread keeps its own between searches, so going back to the board of the
+// next search only copies the chunks that changed since the last one.
+struct SearchContext {
+	GameEngine game;
+	vector<vector<Move> > levels; // Candidates at each depth still to go
+	chrono::steady_clock::time_point deadline;
+	long evaluated;
+	bool expired;
+	chrono::nanoseconds longestMove; // Most a move and going back from it took this search
+};
+
+static thread_local SearchContext context;
+
+// Most points the next depth moves of s.game can be worth, as far as the
+// search got before the deadline (s.expired says if it didn't finish)
+static long lookAhead(SearchContext& s, int depth) {
+	if (depth == 0 || s.game.turns() == 0) return 0;
+	if ((int)s.levels.size() <= depth) s.levels.resize(depth + 1);
+	vector<Move>& moves = s.levels[depth];
+	if (!candidateMoves(s.game.board(), moves, s.deadline)) {
+		s.expired = true;
+		return 0;
+	}
+
+	long best = 0;
+	for (int i = 0; i < moves.size(); i++) {
+		// A move can't be stopped once started, so only start one there is time for
+		chrono::steady_clock::time_point began = chrono::steady_clock::now();
+		if (began + s.longestMove >= s.deadline) {
+			s.expired = true;
+			return best;
+		}
+		GameSnapshot before = s.game.snapshot();
+		long value = s.game.applyMove(moves[i]).scoreDelta;
+		s.evaluated++;
+		s.longestMove = max(s.longestMove, chrono::steady_clock::now() - began);
+		value += lookAhead(s, depth - 1);
+		s.game.restore(before);
+		if (s.expired) return best;
+		best = max(best, value);
+	}
+	return best;
+}
+
+// Threads kept for searches, so that their copies of the game and scratch
+// space outlive each search. Each search reserves idle threads (starting more
+// as needed), so a thread still finishing a move from a search that gave up
+// on it never holds up the next one. Such a thread is left to finish at idle
+// priority, so it doesn't slow down the searches after it either, and then exits.
+class SearchPool {
+public:
+	// One thread of the pool
+	struct Slot {
+		thread worker;
+		function<void()> job; // Empty until run gives it one
+		shared_ptr<int> round; // Threads of its round still working, none once it is done
+		bool reserved = false;
+		bool abandoned = false; // Its round was given up on, it exits when done
+		bool exited = false;
+		condition_variable wake;
+	};
+
+	SearchPool() {
+		stopping = false;
+	}
+
+	~SearchPool() {
+		{
+			lock_guard<mutex> guard(lock);
+			stopping = true;
+		}
+		for (int i = 0; i < slots.size(); i++) {
+			slots[i]->wake.notify_one();
+		}
+		for (int i = 0; i < slots.size(); i++) {
+			slots[i]->worker.join();
+		}
+	}
+
+	// workers idle threads for one search, until release
+	vector<Slot*> reserve(unsigned workers) {
+		lock_guard<mutex> guard(lock);
+		for (int i = 0; i < slots.size(); i++) {
+			if (!slots[i]->exited) continue;
+			slots[i]->worker.join();
+			slots.erase(slots.begin() + i--);
+		}
+		vector<Slot*> picked;
+		for (int i = 0; i < slots.size() && picked.size() < workers; i++) {
+			if (slots[i]->reserved || slots[i]->round || slots[i]->abandoned) continue;
+			slots[i]->reserved = true;
+			picked.push_back(slots[i].get());
+		}
+		while (picked.size() < workers) {
+			slots.emplace_back(new Slot());
+			Slot* slot = slots.back().get();
+			slot->reserved = true;
+			slot->worker = thread([this, slot]() { serve(slot); });
+			picked.push_back(slot);
+		}
+		return picked;
+	}
+
+	// Run work on every thread of picked at once, and wait for them until
+	// giveUp, true if they all finished by then. Threads still working then
+	// carry on with their own copy of work, so it must not refer to anything
+	// the caller frees, and are given up on: they aren't reserved again. Each
+	// thread must have finished the last work it was given.
+	bool run(const vector<Slot*>& picked, function<void()> work,
+		chrono::steady_clock::time_point giveUp = chrono::steady_clock::time_point::max()) {
+		unique_lock<mutex> guard(lock);
+		shared_ptr<int> running = make_shared<int>(picked.size());
+		for (int i = 0; i < picked.size(); i++) {
+			picked[i]->job = work;
+			picked[i]->round = running;
+			picked[i]->wake.notify_one();
+		}
+		if (giveUp == chrono::steady_clock::time_point::max()) {
+			finished.wait(guard, [&]() { return *running == 0; });
+			return true;
+		}
+		if (finished.wait_until(guard, giveUp, [&]() { return *running == 0; })) return true;
+
+		for (int i = 0; i < picked.size(); i++) {
+			if (picked[i]->round != running) continue;
+			picked[i]->abandoned = true;
+			sched_param idle = {};
+			pthread_setschedparam(picked[i]->worker.native_handle(), SCHED_IDLE, &idle);
+		}
+		return false;
+	}
+
+	// Give the threads of a search back, each idle again once it finishes
+	void release(const vector<Slot*>& picked) {
+		lock_guard<mutex> guard(lock);
+		for (int i = 0; i < picked.size(); i++) {
+			picked[i]->reserved = false;
+		}
+	}
+
+private:
+	void serve(Slot* slot) {
+		timedThread() = false;
+		unique_lock<mutex> guard(lock);
+		while (true) {
+			slot->wake.wait(guard, [&]() { return stopping || slot->job; });
+			if (!slot->job) return;
+			function<void()> work = move(slot->job);
+			slot->job = nullptr;
+			guard.unlock();
+
+			work();
+
+			guard.lock();
+			--*slot->round;
+			slot->round.reset();
+			finished.notify_all();
+			if (slot->abandoned) {
+				slot->exited = true;
+				return;
+			}
+		}
+	}
+
+	mutex lock;
+	condition_variable finished;
+	vector<unique_ptr<Slot> > slots;
+	bool stopping;
+};
+
+static SearchPool searchPool;
+
+// One findHint's moves and how they scored, kept alive by the threads
+// searching them, so one still playing a move when findHint returns has them
+struct HintSearch {
+	vector<Move> roots;
+	vector<int> order; // Best of the last depth first
+	unique_ptr<atomic<long>[]> values; // Of each root at this depth, -1 until scored
+	atomic<size_t> next;
+	atomic<bool> scored; // Some root has a value at this depth
+	atomic<long> longestRoot; // Most ns a root has taken at this depth
+	atomic<long> evaluated;
+	chrono::steady_clock::time_point deadline;
+	int depth;
+};
+
+// Score roots of search at search.depth until they run out, or until there
+// isn't time to score another
+static void scoreRoots(HintSearch& search) {
+	SearchContext& s = context;
+	s.deadline = search.deadline;
+	s.evaluated = 0;
+	s.expired = false;
+	for (size_t i = search.next++; i < search.order.size(); i = search.next++) {
+		// Once a root has a value, only start another there is time for
+		chrono::steady_clock::time_point began = chrono::steady_clock::now();
+		if (began >= search.deadline) break;
+		if (search.scored && began + chrono::nanoseconds(search.longestRoot) >= search.deadline) break;
+
+		int root = search.order[i];
+		GameSnapshot before = s.game.snapshot();
+		long value = s.game.applyMove(search.roots[root]).scoreDelta;
+		s.evaluated++;
+		s.longestMove = max(s.longestMove, chrono::steady_clock::now() - began);
+		value += lookAhead(s, search.depth - 1);
+		s.game.restore(before);
+		if (s.expired) break;
+		search.values[root] = value;
+		search.scored = true;
+
+		long took = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - began).count();
+		long longest = search.longestRoot;
+		while (took > longest && !search.longestRoot.compare_exchange_weak(longest, took));
+	}
+	search.evaluated += s.evaluated;
+}
+
+// Best move for game found within budget ms
+Hint findHint(GameEngine& game, int budget, unsigned workers) {
+	Hint hint = { Move(), 0, 0, 0, false };
+	if (game.turns() == 0) return hint;
+
+	// Each thread catches its copy of the game up before the budget starts
+	GameSnapshot now = game.snapshot();
+	if (workers == 0) workers = max(1u, thread::hardware_concurrency());
+	vector<SearchPool::Slot*> threads = searchPool.reserve(workers);
+	searchPool.run(threads, [&now]() {
+		context.game.restore(now);
+		context.longestMove = chrono::nanoseconds(0);
+		sizeScratch(context.game.len(), context.game.height());
+	});
+	sizeScratch(game.len(), game.height());
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	chrono::steady_clock::duration total = chrono::milliseconds(budget);
+
+	// Some move is ready as soon as one group has been found. On a board too
+	// big to look all over, half the time is left for scoring what was found.
+	shared_ptr<HintSearch> search = make_shared<HintSearch>();
+	search->deadline = start + total;
+	search->evaluated = 0;
+	vector<Move>& roots = search->roots;
+	hint.timedOut = !candidateMoves(game.board(), roots, start + total / 2) && roots.empty();
+	if (roots.empty()) {
+		searchPool.release(threads);
+		return hint;
+	}
+	hint.moves = roots[0];
+	vector<SearchPool::Slot*> searching(threads.begin(), threads.begin() + min(threads.size(), roots.size()));
+	search->values.reset(new atomic<long>[roots.size()]);
+
+	// Best moves of the last depth are tried first at the next, so that a
+	// depth cut short has still scored the moves most likely to win. The
+	// threads are only waited for until the deadline, a move still being
+	// played then is left to finish on its own.
+	vector<int>& order = search->order;
+	order.resize(roots.size());
+	iota(order.begin(), order.end(), 0);
+	for (int depth = 1; depth <= game.turns(); depth++) {
+		for (int i = 0; i < roots.size(); i++) {
+			search->values[i] = -1;
+		}
+		search->next = 0;
+		search->scored = false;
+		search->longestRoot = 0;
+		search->depth = depth;
+		bool finished = searchPool.run(searching, [search]() { scoreRoots(*search); }, search->deadline);
+
+		// A depth that didn't finish only counts if it is the first, when any
+		// scored move beats one that wasn't scored at all
+		vector<long> values(roots.size());
+		for (int i = 0; i < roots.size(); i++) {
+			values[i] = search->values[i];
+		}
+		bool complete = finished && all_of(values.begin(), values.end(), [](long value) { return value >= 0; });
+		if (complete || depth == 1) {
+			int best = -1;
+			for (int i = 0; i < order.size(); i++) {
+				if (values[order[i]] > (best < 0 ? -1 : values[best])) best = order[i];
+			}
+			if (best >= 0) {
+				hint.moves = roots[best];
+				hint.score = values[best];
+				hint.depth = complete ? depth : 0;
+			}
+		}
+		if (!complete) break;
+		stable_sort(order.begin(), order.end(), [&](int a, int b) { return values[a] > values[b]; });
+	}
+	searchPool.release(threads);
+	hint.evaluated = search->evaluated;
+	return hint;
+}
+
+// A move in the format validateMove reads
+string moveText(const Move& moves) {
+	string text = "{";
+	for (int i = 0; i < moves.size(); i++) {
+		if (i > 0) text += ",";
+		text += "(" + to_string(moves[i].x) + "," + to_string(moves[i].y) + ")";
+	}
+	return text + "}";
+}
+
+// Tiles of a group as bits, one per tile of the group
+typedef vector<uint64_t> TileSet;
+
+struct TileSetHash {
+	size_t operator()(const TileSet& set) const {
+		uint64_t value = 14695981039346656037ULL;
+		for (int i = 0; i < set.size(); i++) {
+			value = (value ^ set[i]) * 1099511628211ULL;
+		}
+		return value;
+	}
+};
+
+// One LastTurnOracle::best, group by group
+struct OracleSearch {
+	GameEngine* work;
+	GameSnapshot start;
+	long evaluated;
+	long bestScore;
+	Move bestMove;
+
+	// The group being searched, its tiles numbered from 0
+	vector<JGraph::Point<int> > tiles;
+	vector<vector<int> > neighbors;
+	unordered_map<TileSet, long, TileSetHash> scores; // Points of each set of tiles scored
+	unordered_map<TileSet, char, TileSetHash> explored; // Tiles of a path and its last tile, already explored
+	TileSet taken; // Tiles of the path
+	vector<int> path;
+	Move played; // The set being scored, as a move
+	TileSet bestTiles; // Tiles of the best move, empty if it isn't in this group
+
+	// Scratch space of chainsBeaten
+	vector<int> discovered, low, home, blockTop, held;
+	vector<pair<int, int> > frames;
+	vector<TileSet> blocks;
+	vector<char> leafBlock;
+
+	bool has(const TileSet& set, int tile) const {
+		return (set[tile >> 6] >> (tile & 63)) & 1;
+	}
+
+	// Points of taking the tiles of set, played once on the copy of the game
+	long score(const TileSet& set) {
+		auto found = scores.find(set);
+		if (found != scores.end()) return found->second;
+		played.clear();
+		for (int i = 0; i < tiles.size(); i++) {
+			if (has(set, i)) played.push_back(tiles[i]);
+		}
+		long points = work->applyMove(played).scoreDelta;
+		work->restore(start);
+		evaluated++;
+		scores[set] = points;
+		return points;
+	}
+
+	// True if no move taking only tiles of set is worth more than the best
+	// one so far: it takes a subset of the best move's tiles, or all of set
+	// isn't worth more
+	bool beaten(const TileSet& set) {
+		if (!bestTiles.empty()) {
+			bool subset = true;
+			for (int i = 0; i < set.size() && subset; i++) {
+				subset = (set[i] & ~bestTiles[i]) == 0;
+			}
+			if (subset) return true;
+		}
+		return score(set) <= bestScore;
+	}
+
+	// True if no path going on from last through tiles not taken can be worth
+	// more than the best move so far. Such a path only ever takes tiles of a
+	// chain of blocks (biconnected parts of what it can reach) running out
+	// from last, as it can't come back through the tile joining two blocks,
+	// so every such chain has to be beaten. Blocks are found by Tarjan's
+	// algorithm.
+	bool chainsBeaten(int last) {
+		int count = tiles.size();
+		discovered.assign(count, -1);
+		low.assign(count, 0);
+		home.assign(count, -1);
+		blocks.clear();
+		blockTop.clear();
+		int visited = 0;
+		discovered[last] = low[last] = visited++;
+		frames.assign(1, { last, 0 });
+		held.assign(1, last);
+		while (!frames.empty()) {
+			int tile = frames.back().first;
+			int& edge = frames.back().second;
+			if (edge < neighbors[tile].size()) {
+				int next = neighbors[tile][edge++];
+				if (next != last && has(taken, next)) continue;
+				if (discovered[next] < 0) {
+					discovered[next] = low[next] = visited++;
+					frames.push_back({ next, 0 });
+					held.push_back(next);
+				}
+				else {
+					low[tile] = min(low[tile], discovered[next]);
+				}
+				continue;
+			}
+			frames.pop_back();
+			if (frames.empty()) break;
+			int parent = frames.back().first;
+			low[parent] = min(low[parent], low[tile]);
+			if (low[tile] < discovered[parent]) continue;
+
+			// tile and what was found after it make a block with parent
+			blocks.push_back(TileSet(taken.size(), 0));
+			blockTop.push_back(parent);
+			TileSet& block = blocks.back();
+			int member;
+			do {
+				member = held.back();
+				held.pop_back();
+				home[member] = blocks.size() - 1;
+				block[member >> 6] |= 1ULL << (member & 63);
+			} while (member != tile);
+			block[parent >> 6] |= 1ULL << (parent & 63);
+		}
+		if (blocks.empty()) return true;
+
+		// Blocks come out after the blocks beyond them, so backwards each one
+		// can add itself to the chain up to it
+		TileSet reach = taken;
+		leafBlock.assign(blocks.size(), 1);
+		for (int b = blocks.size() - 1; b >= 0; b--) {
+			int parent = (blockTop[b] == last) ? -1 : home[blockTop[b]];
+			const TileSet& before = (parent < 0) ? taken : blocks[parent];
+			for (int i = 0; i < reach.size(); i++) {
+				reach[i] |= blocks[b][i];
+				blocks[b][i] |= before[i];
+			}
+			if (parent >= 0) leafBlock[parent] = 0;
+		}
+		if (beaten(reach)) return true;
+		for (int b = 0; b < blocks.size(); b++) {
+			if (leafBlock[b] && !beaten(blocks[b])) return false;
+		}
+		return true;
+	}
+
+	// Every path that goes on from the current one
+	void explore() {
+		int last = path.back();
+		if (path.size() >= GROUP_MIN_TILES) {
+			long points = score(taken);
+			if (points > bestScore) {
+				bestScore = points;
+				bestTiles = taken;
+				bestMove.clear();
+				for (int i = 0; i < path.size(); i++) {
+					bestMove.push_back(tiles[path[i]]);
+				}
+			}
+		}
+
+		// Whatever follows only depends on the tiles taken and the last one
+		TileSet state = taken;
+		state.push_back(last);
+		if (!explored.emplace(move(state), 1).second) return;
+		if (chainsBeaten(last)) return;
+
+	// Neighbours with the fewest ways on first, as they are likeliest to
+		// lead to a path through everything
+		vector<pair<int, int> > order;
+		for (int next : neighbors[last]) {
+			if (has(taken, next)) continue;
+			int onward = 0;
+			for (int after : neighbors[next]) {
+				if (!has(taken, after)) onward++;
+			}
+			order.push_back({ onward, next });
+		}
+		sort(order.begin(), order.end());
+		for (int i = 0; i < order.size(); i++) {
+			int next = order[i].second;
+			taken[next >> 6] |= 1ULL << (next & 63);
+			path.push_back(next);
+			explore();
+			path.pop_back();
+			taken[next >> 6] &= ~(1ULL << (next & 63));
+		}
+	}
+
+	// Search one group from every tile, unless taking all of it isn't worth
+	// more than the best move so far
+	void searchGroup(const vector<int>& cells, int height) {
+		tiles.clear();
+		neighbors.assign(cells.size(), vector<int>());
+		unordered_map<int, int> number;
+		for (int i = 0; i < cells.size(); i++) {
+			tiles.push_back({ cells[i] / height, cells[i] % height });
+			number[cells[i]] = i;
+		}
+		for (int i = 0; i < tiles.size(); i++) {
+			for (int dx = -1; dx <= 1; dx++) {
+				for (int dy = -1; dy <= 1; dy++) {
+					auto found = number.find((tiles[i].x + dx) * height + tiles[i].y + dy);
+					if ((dx || dy) && found != number.end() && abs(tiles[found->second].y - tiles[i].y) <= 1) {
+						neighbors[i].push_back(found->second);
+					}
+				}
+			}
+		}
+
+		scores.clear();
+		explored.clear();
+		bestTiles.clear();
+		TileSet all((tiles.size() + 63) / 64, 0);
+		for (int i = 0; i < tiles.size(); i++) {
+			all[i >> 6] |= 1ULL << (i & 63);
+		}
+		for (int first = 0; first < tiles.size() && score(all) > bestScore; first++) {
+			taken.assign(all.size(), 0);
+			taken[first >> 6] |= 1ULL << (first & 63);
+			path.assign(1, first);
+			explore();
+		}
+	}
+};
+
+// The move worth the most points on its own
+ExactMove LastTurnOracle::best(GameEngine& game) {
+	ExactMove result = { Move(), 0, 0 };
+	if (game.turns() == 0) return result;
+	const Board& board = ((const GameEngine&)game).board();
+	uint64_t key = (board.hash() ^ (uint64_t)game.rules()) * 1099511628211ULL;
+	auto found = boards.find(key);
+	if (found != boards.end()) {
+		result = found->second;
+		result.evaluated = 0;
+		return result;
+	}
+
+	OracleSearch search;
+	search.work = &work;
+	search.start = game.snapshot();
+	search.evaluated = 0;
+	search.bestScore = -1;
+	work.restore(search.start);
+
+	// The paths hints would try set the score to beat
+	vector<Move> candidates;
+	candidateMoves(board, candidates);
+	for (int i = 0; i < candidates.size(); i++) {
+		long points = work.applyMove(candidates[i]).scoreDelta;
+		work.restore(search.start);
+		search.evaluated++;
+		if (points > search.bestScore) {
+			search.bestScore = points;
+			search.bestMove = candidates[i];
+		}
+	}
+
+	// Then every group that could beat it, biggest first
+	int len = board.size();
+	int height = len ? board[0].size() : 0;
+	vector<vector<int> > groups;
+	vector<char> seen(len * height, 0);
+	for (int cell = 0; cell < len * height; cell++) {
+		Tile::TileType type = board[cell / height][cell % height].type;
+		if (seen[cell] || type == Tile::TileType::BLOCKED || type == Tile::TileType::empty) continue;
+		vector<int> group(1, cell);
+		seen[cell] = 1;
+		for (int i = 0; i < group.size(); i++) {
+			int x = group[i] / height;
+			int y = group[i] % height;
+			for (int nx = max(x - 1, 0); nx <= min(x + 1, len - 1); nx++) {
+				for (int ny = max(y - 1, 0); ny <= min(y + 1, height - 1); ny++) {
+					if (seen[nx * height + ny] || board[nx][ny].type != type) continue;
+					seen[nx * height + ny] = 1;
+					group.push_back(nx * height + ny);
+				}
+			}
+		}
+		if (group.size() >= GROUP_MIN_TILES) groups.push_back(move(group));
+	}
+	sort(groups.begin(), groups.end(), [](const vector<int>& a, const vector<int>& b) { return a.size() > b.size(); });
+	for (int i = 0; i < groups.size(); i++) {
+		search.searchGroup(groups[i], height);
+	}
+
+	if (search.bestScore >= 0) {
+		result.moves = search.bestMove;
+		result.score = search.bestScore;
+	}
+	result.evaluated = search.evaluated;
+	boards[key] = result;
+	return result;
+}
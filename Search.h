@@ -0,0 +1,107 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "GameEngine.h"
+#include <vector>
+#include <chrono>
+#include <unordered_map>
+
+using namespace std;
+
+/*
+ * Looking ahead for good moves. Every search plays its moves on copies of
+ * the game (one per thread, made from a snapshot and stepped back with
+ * snapshots), so the game passed in is only ever snapshotted and the moves
+ * are scored with the same tiles the real game would deal. Built into
+ * libpuzzleengine.a with the engine, implemented in Search.cpp.
+ *
+ *   Hint hint = findHint(game, 50);
+ *   if (!hint.moves.empty()) cout << moveText(hint.moves) << endl;
+ *
+ *   LastTurnOracle oracle;
+ *   ExactMove best = oracle.best(game);
+ */
+
+typedef vector<JGraph::Point<int> > Move;
+
+// Time a hint searches for by default, in ms
+#define HINT_BUDGET 50
+
+// Tiles checked between looks at the clock while finding candidates
+#define CLOCK_STRIDE 1024
+
+// Best move findHint found
+struct Hint {
+	Move moves; // Empty if the board has no move left, or none was found in time
+	long score; // Points it and the best moves after it are worth, as far as depth
+	int depth; // Moves looked ahead in full, 0 if not even the first was scored
+	long evaluated; // Moves played during the search
+	bool timedOut; // The budget ran out before any group was found, so a move may be left
+};
+
+// Moves worth trying on board: for every group of GROUP_MIN_TILES or more,
+// the longest path through it found from a few of its tiles, and the first
+// GROUP_MIN_TILES tiles of that path. Stops at deadline, false if it did, with
+// the moves found by then (possibly none).
+bool candidateMoves(const Board& board, vector<Move>& out,
+	chrono::steady_clock::time_point deadline = chrono::steady_clock::time_point::max());
+
+// Best move for game found within budget ms, by iterative deepening over the
+// candidate moves, each depth scored on workers threads (0 for one per core).
+//
+// The budget holds whatever the board. Finding groups looks at the clock every
+// CLOCK_STRIDE tiles and has half the budget; if no group is found by then,
+// timedOut is set. A move is only started when the moves so far say there is
+// time for it, and findHint stops waiting at the deadline: a thread still
+// playing a move then is left to finish it at idle priority while the best
+// move scored so far (or the first found) is returned. Past budget ms, it
+// takes at most CLOCK_STRIDE tiles of grouping, plus the scheduler's delay in
+// letting the calling thread back on when there are more busy threads than
+// cores (a few ms on one core).
+//
+// Before the budget starts, each thread's copy of the game and scratch space
+// is caught up with game. That copies the chunks changed since the thread's
+// last search, or the whole board the first time, after a resize or on a
+// thread started to replace one left finishing a move.
+Hint findHint(GameEngine& game, int budget, unsigned workers = 0);
+
+// Best move LastTurnOracle found
+struct ExactMove {
+	Move moves; // Empty if the board has no move left
+	long score; // Points it is worth
+	long evaluated; // Sets of tiles scored to find it, 0 if the board was remembered
+};
+
+// The move worth the most points on its own, found exactly. On the last turn
+// the tiles dealt afterwards don't matter, so this is the best move there is.
+//
+// A move's points only depend on which tiles it takes (the cascade and the
+// score don't care about their order), and taking more tiles is never worth
+// less. So each group is searched path by path, tiles kept as bitsets, but:
+// - every set of tiles is scored once, by playing it on a copy of the game
+// - paths with the same tiles and last tile share whatever comes after them,
+//   so each of those is only explored once
+// - a path is dropped when its tiles plus every tile it could still reach
+//   aren't worth more than the best move so far, or when that holds for
+//   every chain of biconnected blocks it could still run through
+// A group with a path through all of it, like a board of one color, is
+// settled as soon as that path is found. Answers are remembered by
+// Board::hash and the rule set, so asking again about the same board costs
+// a hash.
+class LastTurnOracle {
+public:
+	ExactMove best(GameEngine& game);
+
+	void clear() {
+		boards.clear();
+	}
+
+private:
+	GameEngine work; // Where sets of tiles are played and taken back
+	unordered_map<uint64_t, ExactMove> boards;
+};
+
+// A move in the format validateMove reads, {(x0,y0),(x1,y1),...}
+string moveText(const Move& moves);
+
+#endif
@@ -0,0 +1,541 @@
+/*
+-----------------------------
+Puzzle Game utilizing JGraph
+by Tyler Cultice
+-----------------------------
+
+Game server: many sessions on one epoll event loop, renders on a worker pool. See Server.h.
+*/
+
+#include "Server.h"
+#include "Puzzle.h"
+#include "Stats.h"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Longest command a session may send; longer lines end the session
+#define SERVER_MAX_LINE (1 << 20)
+// Replies a session may have waiting before its commands stop being read
+#define SERVER_MAX_OUTPUT (4 << 20)
+// Renders waiting for a worker before show answers busy
+#define SERVER_RENDER_QUEUE 64
+#define SERVER_MAX_EVENTS 64
+
+// A board to render for a session
+struct RenderJob {
+	int fd;
+	unsigned long session;
+	bool jpg; // Send the image itself rather than its path
+	string path;
+	JGraph::Canvas canvas;
+};
+
+// A render that finished, to be answered on the event loop
+struct RenderResult {
+	int fd;
+	unsigned long session;
+	bool jpg;
+	string path;
+	int status; // Same as JGraph::jgraphToJPG
+	string image;
+	JGraph::RenderTimes times;
+};
+
+// Worker threads rendering the boards sessions ask for. The event loop
+// submits jobs and is woken through wakeFd (an eventfd) as they finish.
+class RenderPool {
+public:
+	RenderPool(unsigned workers, int deadline, int wakeFd) {
+		this->deadline = deadline;
+		this->wakeFd = wakeFd;
+		stopping = false;
+		for (unsigned i = 0; i < workers; i++) {
+			threads.push_back(thread([this]() { work(); }));
+		}
+	}
+
+	// Finish the renders that started, drop the ones that are still waiting
+	~RenderPool() {
+		{
+			lock_guard<mutex> guard(lock);
+			stopping = true;
+			jobs.clear();
+		}
+		ready.notify_all();
+		for (int i = 0; i < threads.size(); i++) {
+			threads[i].join();
+		}
+	}
+
+	// Queue a render, false if SERVER_RENDER_QUEUE are already waiting
+	bool submit(RenderJob&& job) {
+		{
+			lock_guard<mutex> guard(lock);
+			if (jobs.size() >= SERVER_RENDER_QUEUE) return false;
+			jobs.push_back(move(job));
+		}
+		ready.notify_one();
+		return true;
+	}
+
+	// Move every finished render into results
+	void finished(vector<RenderResult>& results) {
+		lock_guard<mutex> guard(lock);
+		for (int i = 0; i < done.size(); i++) {
+			results.push_back(move(done[i]));
+		}
+		done.clear();
+	}
+
+private:
+	void work() {
+		while (true) {
+			unique_lock<mutex> guard(lock);
+			ready.wait(guard, [this]() { return stopping || !jobs.empty(); });
+			if (stopping) return;
+			RenderJob job = move(jobs.front());
+			jobs.pop_front();
+			guard.unlock();
+
+			TraceScope frameScope("frame", job.session);
+			RenderResult result = { job.fd, job.session, job.jpg, job.path, 0, "", {} };
+			result.status = JGraph::jgraphToJPG(job.canvas, job.path, true, deadline, &result.times);
+			if (result.status == JGraph::RENDER_OK && job.jpg) {
+				ifstream imageFile(job.path, ios::binary);
+				ostringstream image;
+				image << imageFile.rdbuf();
+				result.image = image.str();
+				unlink(job.path.c_str());
+			}
+
+			guard.lock();
+			done.push_back(move(result));
+			guard.unlock();
+			uint64_t one = 1;
+			if (write(wakeFd, &one, sizeof(one)) < 0) continue;
+		}
+	}
+
+	int deadline;
+	int wakeFd;
+	bool stopping;
+	mutex lock;
+	condition_variable ready;
+	deque<RenderJob> jobs;
+	vector<RenderResult> done;
+	vector<thread> threads;
+};
+
+// One connected player
+struct Session {
+	unsigned long id;
+	int fd;
+	GameEngine game;
+	GameHistory history; // Moves of this game, for undo and redo
+	string in; // Received, not yet played
+	string out; // Replies not yet sent
+	unsigned events; // What epoll is watching for
+	bool rendering; // Waiting on the pool, commands after show wait for it
+	bool closing; // Quit or hung up, closed once everything is answered
+	string framePath;
+};
+
+// Written to by the signal handler to stop the event loop
+static int stopPipe[2] = { -1, -1 };
+
+static void stopServing(int) {
+	char stop = 0;
+	if (write(stopPipe[1], &stop, 1) < 0) return;
+}
+
+// Why a move was rejected, by validateMove status
+static string moveErrorText(int status, int badMove) {
+	switch (status) {
+	case 1: return "format of move is incorrect";
+	case 2: return "move " + to_string(badMove) + " not adjacent or already used";
+	case 3: return "move " + to_string(badMove) + " not same type";
+	case 4: return "moves should be 3+ tiles";
+	default: return "";
+	}
+}
+
+class GameServer {
+public:
+	GameServer(const ServerOptions& options) : options(options) {
+		epollFd = -1;
+		listenFd = -1;
+		wakeFd = -1;
+		nextId = 0;
+		served = 0;
+		moves = 0;
+	}
+
+	~GameServer() {
+		while (!sessions.empty()) {
+			close(*sessions.begin()->second);
+		}
+		pool.reset();
+		if (listenFd >= 0) {
+			::close(listenFd);
+			unlink(options.socketPath.c_str());
+		}
+		if (wakeFd >= 0) ::close(wakeFd);
+		if (epollFd >= 0) ::close(epollFd);
+	}
+
+	// Bind the socket and start the workers, false if the socket can't be used
+	bool start() {
+		sockaddr_un address;
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		if (options.socketPath.empty() || options.socketPath.size() >= sizeof(address.sun_path)) return false;
+		strcpy(address.sun_path, options.socketPath.c_str());
+
+		// A socket left behind by a server that was killed is in the way
+		struct stat existing;
+		if (stat(options.socketPath.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)) {
+			unlink(options.socketPath.c_str());
+		}
+
+		listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (listenFd < 0) return false;
+		if (bind(listenFd, (sockaddr*)&address, sizeof(address)) < 0 || listen(listenFd, SOMAXCONN) < 0) {
+			::close(listenFd);
+			listenFd = -1;
+			return false;
+		}
+
+		epollFd = epoll_create1(EPOLL_CLOEXEC);
+		wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (epollFd < 0 || wakeFd < 0 || pipe2(stopPipe, O_NONBLOCK | O_CLOEXEC) < 0) return false;
+		watch(listenFd, EPOLLIN);
+		watch(wakeFd, EPOLLIN);
+		watch(stopPipe[0], EPOLLIN);
+
+		unsigned workers = options.workers ? options.workers : max(1u, thread::hardware_concurrency());
+		pool.reset(new RenderPool(workers, options.deadline, wakeFd));
+		cout << "Serving games on " << options.socketPath << " with " << workers << " render workers" << endl;
+		return true;
+	}
+
+	// Run the event loop until a signal arrives
+	void run() {
+		epoll_event events[SERVER_MAX_EVENTS];
+		bool stopping = false;
+		while (!stopping) {
+			int count = epoll_wait(epollFd, events, SERVER_MAX_EVENTS, -1);
+			if (count < 0) {
+				if (errno == EINTR) continue;
+				break;
+			}
+			for (int i = 0; i < count; i++) {
+				int fd = events[i].data.fd;
+				if (fd == listenFd) accept();
+				else if (fd == wakeFd) rendered();
+				else if (fd == stopPipe[0]) stopping = true;
+				else {
+					unordered_map<int, unique_ptr<Session> >::iterator it = sessions.find(fd);
+					if (it == sessions.end()) continue;
+					Session& session = *it->second;
+					// Hung up entirely, nobody is left to answer
+					if (events[i].events & (EPOLLHUP | EPOLLERR)) close(session);
+					else if (events[i].events & EPOLLIN) receive(session);
+					else pump(session);
+				}
+			}
+		}
+		cout << "Served " << served << " sessions and " << moves << " moves" << endl;
+	}
+
+private:
+	void watch(int fd, unsigned events) {
+		epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.events = events;
+		event.data.fd = fd;
+		epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+	}
+
+	// Every connection waiting, each a new session with a new game
+	void accept() {
+		while (true) {
+			int fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if (fd < 0) {
+				if (errno == EINTR) continue;
+				return;
+			}
+			unique_ptr<Session> session(new Session());
+			session->id = ++nextId;
+			session->fd = fd;
+			session->events = EPOLLIN;
+			session->rendering = false;
+			session->closing = false;
+			session->framePath = options.socketPath + "." + to_string(session->id) + ".jpg";
+			if (options.seeded) session->game.seed(options.seed + session->id);
+			session->game.setRules(options.rules);
+			session->game.newGame(options.len, options.height);
+			watch(fd, EPOLLIN);
+			sessions[fd] = move(session);
+			served++;
+		}
+	}
+
+	void close(Session& session) {
+		unlink(session.framePath.c_str());
+		::close(session.fd);
+		sessions.erase(session.fd);
+	}
+
+	// Read everything the session sent, then play it
+	void receive(Session& session) {
+		char buffer[64 * 1024];
+		while (session.in.size() < SERVER_MAX_LINE) {
+			ssize_t length = recv(session.fd, buffer, sizeof(buffer), 0);
+			if (length > 0) {
+				session.in.append(buffer, length);
+				continue;
+			}
+			if (length < 0 && errno == EINTR) continue;
+			if (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+			if (length < 0) {
+				close(session);
+				return;
+			}
+			// Hung up, answer what it sent (a last line without a newline too) then close
+			if (!session.in.empty() && session.in.back() != '\n') session.in += '\n';
+			session.closing = true;
+			break;
+		}
+		pump(session);
+	}
+
+	// Play every complete command, unless a render is out or the replies
+	// are backed up, send what can be sent and close the session once it
+	// is done
+	void pump(Session& session) {
+		size_t start = 0;
+		while (!session.rendering && session.out.size() < SERVER_MAX_OUTPUT) {
+			size_t end = session.in.find('\n', start);
+			if (end == string::npos) break;
+			string line = session.in.substr(start, end - start);
+			start = end + 1;
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			command(session, line);
+		}
+		session.in.erase(0, start);
+		if (session.in.size() >= SERVER_MAX_LINE && session.in.find('\n') == string::npos) {
+			reply(session, "error 9 line too long");
+			session.in.clear();
+			session.closing = true;
+		}
+
+		// Send
+		while (!session.out.empty()) {
+			ssize_t length = send(session.fd, session.out.data(), session.out.size(), MSG_NOSIGNAL);
+			if (length < 0 && errno == EINTR) continue;
+			if (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+			if (length < 0) {
+				close(session);
+				return;
+			}
+			session.out.erase(0, length);
+		}
+
+		if (session.closing && !session.rendering && session.out.empty() && session.in.find('\n') == string::npos) {
+			close(session);
+			return;
+		}
+
+		// Stop reading while there is a full line's worth waiting, so a
+		// session can't queue up more than it is answered
+		unsigned events = (!session.closing && session.in.size() < SERVER_MAX_LINE) ? EPOLLIN : 0;
+		if (!session.out.empty()) events |= EPOLLOUT;
+		if (events != session.events) {
+			epoll_event event;
+			memset(&event, 0, sizeof(event));
+			event.events = events;
+			event.data.fd = session.fd;
+			epoll_ctl(epollFd, EPOLL_CTL_MOD, session.fd, &event);
+			session.events = events;
+		}
+	}
+
+	void reply(Session& session, const string& line) {
+		session.out += line;
+		session.out += '\n';
+	}
+
+	// Play one command of the protocol in Server.h
+	void command(Session& session, string line) {
+		// 10 Error statuses:
+		// 1-4 The move was rejected, as GameEngine::validateMove
+		// 5 The game is over, new starts another
+		// 6 Unknown command
+		// 7 The board couldn't be rendered
+		// 8 Too many renders waiting, try again
+		// 9 The line was too long, the session is closed
+		// 10 Nothing to undo or redo
+		GameEngine& game = session.game;
+		istringstream words(line);
+		string word;
+		words >> word;
+		if (word.empty()) return;
+
+		if (word[0] == '{') {
+			if (game.turns() == 0) {
+				reply(session, "error 5 game over");
+				return;
+			}
+			PhaseTimer turnTimer(Phase::turn);
+			vector<JGraph::Point<int>> moves;
+			int badMove;
+			PhaseTimer parseTimer(Phase::parse);
+			int moveStatus = game.validateMove(line, moves, badMove);
+			parseTimer.stop();
+			if (moveStatus != 0) {
+				reply(session, "error " + to_string(moveStatus) + " " + moveErrorText(moveStatus, badMove));
+				return;
+			}
+			session.history.push(game);
+			MoveResult result = game.applyMove(moves);
+			this->moves++;
+			reply(session, "ok " + to_string(result.scoreDelta) + " " + to_string(game.score()) + " " + to_string(game.turns())
+				+ " " + to_string(result.popped) + " " + to_string(result.waves));
+		}
+		else if (word == "board") {
+			// Columns in save file hex
+			const Board& board = game.board();
+			string text = "board " + to_string(game.len()) + "x" + to_string(game.height()) + " "
+				+ to_string(game.score()) + " " + to_string(game.turns()) + " ";
+			for (int i = 0; i < game.len(); i++) {
+				if (i > 0) text += '/';
+				for (int j = 0; j < game.height(); j++) {
+					text += "0123456789abcdefghijklmnopqrstuvwxyz"[3 * (int)board[i][j].type + board[i][j].size];
+				}
+			}
+			reply(session, text);
+		}
+		else if (word == "undo" || word == "redo") {
+			bool undo = (word == "undo");
+			if (!(undo ? session.history.undo(game) : session.history.redo(game))) {
+				reply(session, "error 10 nothing to " + word);
+				return;
+			}
+			reply(session, word + " " + to_string(game.score()) + " " + to_string(game.turns()));
+		}
+		else if (word == "show") {
+			string as;
+			words >> as;
+			PhaseTimer timer(Phase::canvas);
+			RenderJob job = { session.fd, session.id, as == "jpg", session.framePath, game.canvas() };
+			timer.stop();
+			if (!pool->submit(move(job))) {
+				reply(session, "error 8 busy");
+				return;
+			}
+			session.rendering = true;
+		}
+		else if (word == "new") {
+			string size;
+			int len = options.len;
+			int height = options.height;
+			if (words >> size && !parseBoardSize(size, len, height)) {
+				reply(session, "error 6 size must be WxH, " + to_string(BOARD_MIN) + " to " + to_string(BOARD_MAX));
+				return;
+			}
+			game.newGame(len, height);
+			session.history.clear();
+			reply(session, "new " + to_string(len) + "x" + to_string(height));
+		}
+		else if (word == "quit" || word == "Quit") {
+			reply(session, "bye " + to_string(game.score()));
+			session.in.clear();
+			session.closing = true;
+		}
+		else {
+			reply(session, "error 6 unknown command");
+		}
+	}
+
+	// Answer the sessions whose renders finished
+	void rendered() {
+		uint64_t count;
+		if (read(wakeFd, &count, sizeof(count)) < 0 && errno != EAGAIN) return;
+		vector<RenderResult> results;
+		pool->finished(results);
+		for (int i = 0; i < results.size(); i++) {
+			RenderResult& result = results[i];
+			stats().record(Phase::jgraph, result.times.jgraph);
+			stats().record(Phase::convert, result.times.convert);
+			traceRender(result.times);
+
+			// The session may have gone while it rendered
+			unordered_map<int, unique_ptr<Session> >::iterator it = sessions.find(result.fd);
+			if (it == sessions.end() || it->second->id != result.session) {
+				unlink(result.path.c_str());
+				continue;
+			}
+			Session& session = *it->second;
+			session.rendering = false;
+			if (result.status == JGraph::RENDER_TIMEOUT) reply(session, "error 7 render took too long");
+			else if (result.status != JGraph::RENDER_OK) reply(session, "error 7 render failed");
+			else if (result.jpg) {
+				reply(session, "jpg " + to_string(result.image.size()));
+				session.out += result.image;
+			}
+			else reply(session, "frame " + result.path);
+			pump(session);
+		}
+	}
+
+	ServerOptions options;
+	int epollFd;
+	int listenFd;
+	int wakeFd;
+	unique_ptr<RenderPool> pool;
+	unordered_map<int, unique_ptr<Session> > sessions;
+	unsigned long nextId;
+	unsigned long served;
+	unsigned long moves;
+};
+
+// Serve games on options.socketPath until SIGINT or SIGTERM
+int serveGames(const ServerOptions& options) {
+	// 2 Statuses:
+	// 0 Served until stopped
+	// 1 Unable to listen on the socket
+	int status = 0;
+	{
+		GameServer server(options);
+		if (server.start()) {
+			struct sigaction stop;
+			memset(&stop, 0, sizeof(stop));
+			stop.sa_handler = stopServing;
+			sigaction(SIGINT, &stop, NULL);
+			sigaction(SIGTERM, &stop, NULL);
+			server.run();
+		}
+		else status = 1;
+	}
+	for (int i = 0; i < 2; i++) {
+		if (stopPipe[i] >= 0) ::close(stopPipe[i]);
+		stopPipe[i] = -1;
+	}
+	return status;
+}
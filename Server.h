@@ -0,0 +1,51 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "GameEngine.h"
+#include <string>
+
+using namespace std;
+
+/*
+ * Many games served from one process over a local Unix socket. A single
+ * epoll event loop reads every session's commands and plays their moves,
+ * each session with its own GameEngine; renders go to a bounded pool of
+ * worker threads so a slow jgraph never holds up the other players.
+ * Implemented in Server.cpp, and run with ./puzzle --serve path.
+ *
+ * The protocol is one command per line, answered in order with one line
+ * (and for "show jpg", the image after it):
+ *
+ *   {(x0,y0),(x1,y1),...}  ok <points> <score> <turns> <popped> <waves>
+ *   undo                   undo <score> <turns>
+ *   redo                   redo <score> <turns>
+ *   board                  board <W>x<H> <score> <turns> <columns>
+ *   show                   frame <path>
+ *   show jpg               jpg <length>, then length bytes of JPG
+ *   new [WxH]              new <W>x<H>
+ *   quit                   bye <score>
+ *
+ * board gives each column top to bottom in save file hex (3 * color + size,
+ * f is blocked), columns separated by '/'. A frame is kept at path until
+ * the next show or the end of the session. A move on the last turn answers
+ * ok with 0 turns; new starts another game, or undo takes the move back.
+ * undo and redo step through the moves of the current game. Anything that
+ * fails answers error <status> <message>, with the status from the list in
+ * Server.cpp.
+ */
+
+struct ServerOptions {
+	string socketPath;
+	unsigned workers; // Render threads, 0 for one per core
+	int len; // Size of new games
+	int height;
+	bool seeded; // Session n is seeded with seed + n
+	unsigned long seed;
+	int deadline; // Longest a render may take in ms, 0 waits as long as it takes
+	RuleSet rules; // Rules of every session's games
+};
+
+// Serve games on options.socketPath until SIGINT or SIGTERM
+int serveGames(const ServerOptions& options);
+
+#endif
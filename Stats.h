@@ -0,0 +1,291 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <chrono>
+#include <string>
+#include <ostream>
+#include <fstream>
+#include <iomanip>
+#include <cstdint>
+#include <cstring>
+#include "Trace.h"
+#include "AllocTracker.h"
+
+using namespace std;
+
+/*
+ * Latency statistics for each phase of a turn. Always compiled in; when
+ * disabled a PhaseTimer costs one branch, when enabled two steady_clock
+ * reads and a histogram increment. Phases also go to the trace (Trace.h)
+ * when one is being recorded.
+ *
+ * Time a phase with a PhaseTimer in scope:
+ *
+ *   PhaseTimer timer(Phase::parse);
+ *
+ * (ending it early with stop() if needed), or record a duration measured
+ * elsewhere with stats().record(). Reports give count, mean, p50/p95/p99
+ * and max for each phase, and with allocTracking on (AllocTracker.h) the
+ * heap allocations and bytes per call and the peak RSS.
+ */
+
+// Phases that get timed
+enum class Phase {
+	parse, // Parsing and validating a move
+	gameProcedure, // Whole move, including tileFall
+	tileFall, // Gravity and refill
+	canvas, // Building the JGraph canvas
+	serialize, // Canvas to JGraph script
+	jgraph, // jgraph process, from start until it exits
+	convert, // convert process, from jgraph exiting until it exits
+	turn, // Everything between reading a move and being ready for the next
+	COUNT
+};
+
+inline const char* phaseName(Phase phase) {
+	switch (phase) {
+	case Phase::parse: return "parse";
+	case Phase::gameProcedure: return "gameProcedure";
+	case Phase::tileFall: return "tileFall";
+	case Phase::canvas: return "canvas";
+	case Phase::serialize: return "serialize";
+	case Phase::jgraph: return "jgraph";
+	case Phase::convert: return "convert";
+	case Phase::turn: return "turn";
+	default: return "";
+	}
+}
+
+// HDR style histogram of nanosecond latencies: buckets are exact below 16ns,
+// then 16 linear sub-buckets per power of two, so values are kept to within
+// about 6% from nanoseconds up to hours with fixed memory
+class LatencyHistogram {
+public:
+	static const int SUB_BITS = 4;
+	static const int SUB_COUNT = 1 << SUB_BITS;
+	static const int BUCKET_COUNT = (64 - SUB_BITS + 1) * SUB_COUNT;
+
+	LatencyHistogram() {
+		clear();
+	}
+
+	void clear() {
+		memset(buckets, 0, sizeof(buckets));
+		count = 0;
+		total = 0;
+		max = 0;
+	}
+
+	void record(uint64_t ns) {
+		buckets[bucketOf(ns)]++;
+		count++;
+		total += ns;
+		if (ns > max) max = ns;
+	}
+
+	// Fold in the values of another histogram
+	void add(const LatencyHistogram& other) {
+		for (int i = 0; i < BUCKET_COUNT; i++) {
+			buckets[i] += other.buckets[i];
+		}
+		count += other.count;
+		total += other.total;
+		if (other.max > max) max = other.max;
+	}
+
+	// Upper edge of the bucket holding the p'th value (0 < p <= 1)
+	uint64_t percentile(double p) const {
+		if (count == 0) return 0;
+		uint64_t rank = (uint64_t)(p * count + 0.5);
+		if (rank < 1) rank = 1;
+		uint64_t seen = 0;
+		for (int i = 0; i < BUCKET_COUNT; i++) {
+			seen += buckets[i];
+			if (seen >= rank) {
+				uint64_t upper = bucketUpper(i);
+				return (upper < max) ? upper : max;
+			}
+		}
+		return max;
+	}
+
+	double mean() const {
+		return count ? (double)total / count : 0;
+	}
+
+	uint64_t count;
+	uint64_t total;
+	uint64_t max;
+
+private:
+	static int bucketOf(uint64_t ns) {
+		if (ns < SUB_COUNT) return (int)ns;
+		int msb = 63 - __builtin_clzll(ns);
+		int shift = msb - SUB_BITS;
+		return ((shift + 1) << SUB_BITS) + (int)((ns >> shift) & (SUB_COUNT - 1));
+	}
+
+	static uint64_t bucketUpper(int bucket) {
+		if (bucket < SUB_COUNT) return bucket;
+		int shift = (bucket >> SUB_BITS) - 1;
+		uint64_t sub = bucket & (SUB_COUNT - 1);
+		return ((SUB_COUNT + sub + 1) << shift) - 1;
+	}
+
+	uint64_t buckets[BUCKET_COUNT];
+};
+
+// Heap use of every call of one phase
+struct PhaseAllocs {
+	uint64_t calls;
+	uint64_t allocs;
+	uint64_t bytes;
+	uint64_t maxAllocs; // Most allocations in a single call
+	uint64_t lastAllocs; // Allocations in the latest call, 0 in steady state
+};
+
+class Stats {
+public:
+	Stats() {
+		enabled = false;
+		memset(allocs, 0, sizeof(allocs));
+	}
+
+	bool enabled;
+	LatencyHistogram phases[(int)Phase::COUNT];
+	PhaseAllocs allocs[(int)Phase::COUNT];
+
+	void record(Phase phase, uint64_t ns) {
+		if (enabled) phases[(int)phase].record(ns);
+	}
+
+	void recordAllocs(Phase phase, const AllocCounts& start, const AllocCounts& end) {
+		if (!enabled) return;
+		PhaseAllocs& a = allocs[(int)phase];
+		uint64_t count = end.allocs - start.allocs;
+		a.calls++;
+		a.allocs += count;
+		a.bytes += end.bytes - start.bytes;
+		if (count > a.maxAllocs) a.maxAllocs = count;
+		a.lastAllocs = count;
+	}
+
+	// Table of every phase that has been timed
+	void report(ostream& out) {
+		out << left << setw(15) << "phase" << right << setw(8) << "count"
+			<< setw(12) << "mean us" << setw(12) << "p50 us" << setw(12) << "p95 us"
+			<< setw(12) << "p99 us" << setw(12) << "max us";
+		if (allocTracking) {
+			out << setw(12) << "allocs/call" << setw(12) << "bytes/call" << setw(12) << "max allocs" << setw(12) << "last allocs";
+		}
+		out << endl;
+		for (int i = 0; i < (int)Phase::COUNT; i++) {
+			LatencyHistogram& h = phases[i];
+			if (h.count == 0) continue;
+			out << left << setw(15) << phaseName((Phase)i) << right << setw(8) << h.count
+				<< fixed << setprecision(1)
+				<< setw(12) << h.mean() / 1000 << setw(12) << h.percentile(0.50) / 1000.0
+				<< setw(12) << h.percentile(0.95) / 1000.0 << setw(12) << h.percentile(0.99) / 1000.0
+				<< setw(12) << h.max / 1000.0;
+			PhaseAllocs& a = allocs[i];
+			if (allocTracking && a.calls) {
+				out << setw(12) << (double)a.allocs / a.calls << setw(12) << (double)a.bytes / a.calls
+					<< setw(12) << a.maxAllocs << setw(12) << a.lastAllocs;
+			}
+			out << endl;
+		}
+		if (allocTracking) {
+			out << "peak RSS " << peakRSSKB() << " KB" << endl;
+		}
+		out.unsetf(ios::floatfield);
+		out << setprecision(6);
+	}
+
+	// Same numbers as JSON, in nanoseconds
+	void toJSON(ostream& out) {
+		out << "{\n  \"phases\": [\n";
+		bool first = true;
+		for (int i = 0; i < (int)Phase::COUNT; i++) {
+			LatencyHistogram& h = phases[i];
+			if (h.count == 0) continue;
+			if (!first) out << ",\n";
+			first = false;
+			out << "    {\"phase\": \"" << phaseName((Phase)i) << "\", \"count\": " << h.count
+				<< ", \"mean_ns\": " << (uint64_t)h.mean()
+				<< ", \"p50_ns\": " << h.percentile(0.50)
+				<< ", \"p95_ns\": " << h.percentile(0.95)
+				<< ", \"p99_ns\": " << h.percentile(0.99)
+				<< ", \"max_ns\": " << h.max;
+			PhaseAllocs& a = allocs[i];
+			if (allocTracking && a.calls) {
+				out << ", \"allocs_per_call\": " << (double)a.allocs / a.calls
+					<< ", \"bytes_per_call\": " << (double)a.bytes / a.calls
+					<< ", \"max_allocs\": " << a.maxAllocs
+					<< ", \"last_allocs\": " << a.lastAllocs;
+			}
+			out << "}";
+		}
+		out << "\n  ]";
+		if (allocTracking) {
+			out << ",\n  \"peak_rss_kb\": " << peakRSSKB();
+		}
+		out << "\n}\n";
+	}
+
+	// 0 on success, 1 if the file couldn't be written
+	int exportTo(string fileName) {
+		ofstream out(fileName, ios::trunc);
+		if (!out.is_open()) return 1;
+		toJSON(out);
+		return out ? 0 : 1;
+	}
+};
+
+// The statistics for this process
+inline Stats& stats() {
+	static Stats processStats;
+	return processStats;
+}
+
+inline uint64_t nanosSince(chrono::steady_clock::time_point start) {
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+}
+
+// False on helper threads whose work isn't a phase of a turn (such as the
+// hint search), so they neither skew the phases nor race on them
+inline bool& timedThread() {
+	static thread_local bool timed = true;
+	return timed;
+}
+
+// Times its own scope as phase
+class PhaseTimer {
+public:
+	PhaseTimer(Phase phase) {
+		this->phase = phase;
+		active = timedThread() && (stats().enabled || trace().enabled);
+		if (active) {
+			startAllocs = allocCounts();
+			start = chrono::steady_clock::now();
+		}
+	}
+	~PhaseTimer() {
+		stop();
+	}
+	// End the phase before the end of the scope
+	void stop() {
+		if (!active) return;
+		uint64_t ns = nanosSince(start);
+		stats().record(phase, ns);
+		if (allocTracking) stats().recordAllocs(phase, startAllocs, allocCounts());
+		trace().complete(phaseName(phase), trace().toNanos(start), ns);
+		active = false;
+	}
+private:
+	Phase phase;
+	bool active;
+	chrono::steady_clock::time_point start;
+	AllocCounts startAllocs;
+};
+
+#endif
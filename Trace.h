@@ -0,0 +1,187 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <cstdlib>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+using namespace std;
+
+/*
+ * Chrome/Perfetto trace event output (chrome://tracing or ui.perfetto.dev).
+ *
+ * Each thread records complete ("X") events into its own preallocated ring
+ * buffer, so recording never allocates or locks; once a buffer is full the
+ * oldest events are overwritten. Everything is written out as JSON when the
+ * process exits.
+ *
+ * Start with trace().start("out.json"), then time a scope with
+ *
+ *   TraceScope scope("parse");
+ *
+ * or add an event measured elsewhere with trace().complete(). Events for a
+ * child process use its PID as the track, so jgraph and convert show up
+ * next to the thread that started them.
+ */
+
+class Trace;
+inline Trace& trace();
+
+class Trace {
+public:
+	static const size_t EVENTS_PER_THREAD = 1 << 16;
+
+	struct Event {
+		const char* name;
+		int64_t start_ns;
+		int64_t duration_ns;
+		int tid; // Thread, or the PID of a child process
+		long arg; // Shown as "n" in the event's args, if not -1
+		bool child;
+	};
+
+	// Ring buffer of one thread's events
+	struct ThreadBuffer {
+		ThreadBuffer() : events(EVENTS_PER_THREAD) {
+			next = 0;
+			tid = (int)syscall(SYS_gettid);
+		}
+		vector<Event> events;
+		size_t next;
+		int tid;
+	};
+
+	Trace() {
+		enabled = false;
+		origin = chrono::steady_clock::now();
+	}
+
+	bool enabled;
+
+	// Record from now on and write fileName when the process exits
+	void start(string fileName) {
+		this->fileName = fileName;
+		enabled = true;
+		atexit([]() { trace().flush(); });
+	}
+
+	int64_t now() {
+		return toNanos(chrono::steady_clock::now());
+	}
+
+	int64_t toNanos(chrono::steady_clock::time_point time) {
+		return chrono::duration_cast<chrono::nanoseconds>(time - origin).count();
+	}
+
+	void complete(const char* name, int64_t start_ns, int64_t duration_ns, long arg = -1) {
+		record(name, start_ns, duration_ns, 0, arg, false);
+	}
+
+	// Lifetime of a child process, on a track of its own
+	void child(const char* name, int pid, int64_t start_ns, int64_t duration_ns) {
+		record(name, start_ns, duration_ns, pid, -1, true);
+	}
+
+	// Write every buffered event as JSON, 0 on success
+	int flush() {
+		if (fileName.empty()) return 1;
+		ofstream out(fileName, ios::trunc);
+		if (!out.is_open()) return 1;
+
+		int pid = getpid();
+		out << "{\"traceEvents\": [\n";
+		out << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << pid << ", \"args\": {\"name\": \"puzzle\"}}";
+
+		lock_guard<mutex> lock(buffersLock);
+		for (size_t b = 0; b < buffers.size(); b++) {
+			ThreadBuffer& buffer = *buffers[b];
+			size_t first = (buffer.next > EVENTS_PER_THREAD) ? buffer.next - EVENTS_PER_THREAD : 0;
+			for (size_t i = first; i < buffer.next; i++) {
+				Event& e = buffer.events[i % EVENTS_PER_THREAD];
+				int tid = e.child ? e.tid : buffer.tid;
+				if (e.child) {
+					out << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << pid << ", \"tid\": " << tid
+						<< ", \"args\": {\"name\": \"" << e.name << " " << e.tid << "\"}}";
+				}
+				out << ",\n{\"name\": \"" << e.name << "\", \"ph\": \"X\", \"pid\": " << pid << ", \"tid\": " << tid
+					<< ", \"ts\": " << e.start_ns / 1000.0 << ", \"dur\": " << e.duration_ns / 1000.0;
+				if (e.arg != -1) {
+					out << ", \"args\": {\"n\": " << e.arg << "}";
+				}
+				out << "}";
+			}
+		}
+		out << "\n]}\n";
+		return out ? 0 : 1;
+	}
+
+private:
+	void record(const char* name, int64_t start_ns, int64_t duration_ns, int tid, long arg, bool child) {
+		if (!enabled) return;
+		ThreadBuffer& buffer = threadBuffer();
+		Event& e = buffer.events[buffer.next % EVENTS_PER_THREAD];
+		e.name = name;
+		e.start_ns = start_ns;
+		e.duration_ns = duration_ns;
+		e.tid = tid;
+		e.arg = arg;
+		e.child = child;
+		buffer.next++;
+	}
+
+	// This thread's buffer, made the first time the thread records an event.
+	// Buffers belong to the trace so events outlive the threads.
+	ThreadBuffer& threadBuffer() {
+		static thread_local ThreadBuffer* buffer = NULL;
+		if (!buffer) {
+			lock_guard<mutex> lock(buffersLock);
+			buffers.push_back(unique_ptr<ThreadBuffer>(new ThreadBuffer()));
+			buffer = buffers.back().get();
+		}
+		return *buffer;
+	}
+
+	string fileName;
+	chrono::steady_clock::time_point origin;
+	mutex buffersLock;
+	vector<unique_ptr<ThreadBuffer> > buffers;
+};
+
+// The trace for this process
+inline Trace& trace() {
+	static Trace processTrace;
+	return processTrace;
+}
+
+// Records its own scope as an event
+class TraceScope {
+public:
+	TraceScope(const char* name, long arg = -1) {
+		this->name = name;
+		this->arg = arg;
+		active = trace().enabled;
+		if (active) start = trace().now();
+	}
+	~TraceScope() {
+		stop();
+	}
+	// End the event before the end of the scope
+	void stop() {
+		if (active) trace().complete(name, start, trace().now() - start, arg);
+		active = false;
+	}
+private:
+	const char* name;
+	long arg;
+	bool active;
+	int64_t start;
+};
+
+#endif
@@ -0,0 +1,693 @@
+/*
+-----------------------------
+Benchmarks for the Puzzle Game
+-----------------------------
+
+Times the game engine and the JGraph render path and prints the results as
+JSON, so changes can be compared run to run.
+
+Build and run with make bench, or by calling:
+
+./puzzle_bench [--filter text] [--min-time ms] [--saves dir] [--render] [--perf] [--out file] [--verify]
+
+--filter text --- Only run benchmarks whose name contains text
+--min-time ms --- Time to spend on each benchmark (default 200)
+--saves dir --- Directory of save files to use as inputs (default saveStates)
+--render --- Also time jgraphToJPG end to end (needs jgraph and convert)
+--perf --- Also count cycles, instructions, branch and cache misses per kernel call
+           (reading the counters adds a little to every timing)
+--out file --- Write the JSON to file instead of standard out
+--verify --- Check the engine instead of timing it (make check): the last-turn
+             oracle against trying every path on small boards, and the groups
+             kept after every move of random games against building them again.
+             Exits 1 if any check fails.
+
+Every benchmark reports ns/op (mean), p50/p90/p99/max and the heap
+allocations and bytes allocated per op, plus hardware counters with --perf.
+*/
+
+#include "GameEngine.h"
+#include "Search.h"
+#include "PerfCounters.h"
+#include "AllocTracker.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+#include <cstdlib>
+#include <dirent.h>
+
+using namespace std;
+
+// Result of one benchmark on one input
+struct BenchResult {
+	string name;
+	string input;
+	long iterations;
+	double mean_ns;
+	double p50_ns;
+	double p90_ns;
+	double p99_ns;
+	double max_ns;
+	double allocs_per_op;
+	double bytes_per_op;
+	string counters; // perf().toJSON() of the timed runs, empty without --perf
+};
+
+vector<BenchResult> results;
+string benchFilter;
+double minTimeMs = 200;
+
+// Cost of reading the clock, taken off every sample
+double clockOverhead = 0;
+
+void calibrateClock() {
+	double best = 1e9;
+	for (int i = 0; i < 1000; i++) {
+		chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+		chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+		best = min(best, (double)chrono::duration_cast<chrono::nanoseconds>(t1 - t0).count());
+	}
+	clockOverhead = best;
+}
+
+double percentile(const vector<double>& sorted, double p) {
+	size_t index = (size_t)(p * (sorted.size() - 1) + 0.5);
+	return sorted[index];
+}
+
+// Run op until minTimeMs has passed (at least a few times), calling setup
+// untimed before each op
+void bench(string name, string input, function<void()> setup, function<void()> op) {
+	if (name.find(benchFilter) == string::npos) return;
+
+	// Warm up caches and the allocator
+	for (int i = 0; i < 3; i++) {
+		setup();
+		op();
+	}
+	perf().clear();
+
+	vector<double> times;
+	long allocs = 0;
+	long bytes = 0;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	chrono::duration<double, milli> spent(0);
+	while (times.size() < 10 || (spent.count() < minTimeMs && times.size() < 1000000)) {
+		setup();
+
+		AllocCounts before = allocCounts();
+		chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+		op();
+		chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+		AllocCounts after = allocCounts();
+		allocs += after.allocs - before.allocs;
+		bytes += after.bytes - before.bytes;
+
+		double ns = chrono::duration_cast<chrono::nanoseconds>(t1 - t0).count() - clockOverhead;
+		times.push_back(max(ns, 0.0));
+		spent = chrono::steady_clock::now() - start;
+	}
+
+	BenchResult result;
+	result.name = name;
+	result.input = input;
+	result.iterations = times.size();
+	double total = 0;
+	for (int i = 0; i < times.size(); i++) total += times[i];
+	result.mean_ns = total / times.size();
+	sort(times.begin(), times.end());
+	result.p50_ns = percentile(times, 0.50);
+	result.p90_ns = percentile(times, 0.90);
+	result.p99_ns = percentile(times, 0.99);
+	result.max_ns = times.back();
+	result.allocs_per_op = (double)allocs / times.size();
+	result.bytes_per_op = (double)bytes / times.size();
+	if (perf().enabled) {
+		ostringstream counters;
+		perf().toJSON(counters);
+		result.counters = counters.str();
+	}
+	results.push_back(result);
+
+	cerr << name << " [" << input << "]: " << result.mean_ns << " ns/op" << endl;
+}
+
+// The game being benchmarked
+GameEngine engine;
+
+// A game to run benchmarks on
+struct BenchGame {
+	string name;
+	GameEngine state;
+	vector<JGraph::Point<int>> move;
+	string moveText;
+};
+
+void loadGame(const BenchGame& game) {
+	engine = game.state.clone();
+}
+
+// Depth first search for a path of length tiles of the same type
+bool findPath(vector<JGraph::Point<int>>& path, vector<vector<bool>>& used, int length) {
+	if (path.size() == length) return true;
+	const Board& board = engine.board();
+	JGraph::Point<int> last = path.back();
+	Tile::TileType type = board[path[0].x][path[0].y].type;
+	for (int dx = -1; dx <= 1; dx++) {
+		for (int dy = -1; dy <= 1; dy++) {
+			int x = last.x + dx;
+			int y = last.y + dy;
+			if (x < 0 || x >= engine.len() || y < 0 || y >= engine.height()) continue;
+			if (used[x][y] || board[x][y].type != type) continue;
+			used[x][y] = true;
+			path.push_back({ x, y });
+			if (findPath(path, used, length)) return true;
+			path.pop_back();
+			used[x][y] = false;
+		}
+	}
+	return false;
+}
+
+// First move of the given length on the current board, empty if there is none
+vector<JGraph::Point<int>> findMove(int length) {
+	const Board& board = engine.board();
+	for (int x = 0; x < engine.len(); x++) {
+		for (int y = 0; y < engine.height(); y++) {
+			Tile::TileType type = board[x][y].type;
+			if (type == Tile::TileType::BLOCKED || type == Tile::TileType::empty) continue;
+			vector<JGraph::Point<int>> path = { { x, y } };
+			vector<vector<bool>> used(engine.len(), vector<bool>(engine.height(), false));
+			used[x][y] = true;
+			if (findPath(path, used, length)) return path;
+		}
+	}
+	return vector<JGraph::Point<int>>();
+}
+
+string moveToString(const vector<JGraph::Point<int>>& move) {
+	string text = "{";
+	for (int i = 0; i < move.size(); i++) {
+		if (i) text += ",";
+		text += "(" + to_string(move[i].x) + "," + to_string(move[i].y) + ")";
+	}
+	return text + "}";
+}
+
+BenchGame captureGame(string name, int moveLength) {
+	BenchGame game;
+	game.name = name;
+	game.state = engine.clone();
+	game.move = findMove(moveLength);
+	game.moveText = moveToString(game.move);
+	return game;
+}
+
+// Every save in dir
+vector<BenchGame> loadSaves(string dir) {
+	vector<BenchGame> games;
+	vector<string> names;
+	DIR* saves = opendir(dir.c_str());
+	if (!saves) return games;
+	for (dirent* entry = readdir(saves); entry; entry = readdir(saves)) {
+		string name = entry->d_name;
+		if (name.size() > 4 && name.substr(name.size() - 4) == ".txt") names.push_back(name);
+	}
+	closedir(saves);
+	sort(names.begin(), names.end());
+
+	for (int i = 0; i < names.size(); i++) {
+		if (engine.load(dir + "/" + names[i]) != 0) continue;
+		games.push_back(captureGame(names[i], 3));
+	}
+	return games;
+}
+
+// Fill every tile that isn't blocked with a green tile about to pop
+void fillCascade() {
+	Board& board = engine.board();
+	for (int x = 0; x < engine.len(); x++) {
+		for (int y = 0; y < engine.height(); y++) {
+			if (board[x][y].type == Tile::TileType::BLOCKED) continue;
+			board[x][y].type = Tile::TileType::green;
+			board[x][y].size = 2;
+		}
+	}
+}
+
+// Worst and best cases that aren't in the shipped saves
+vector<BenchGame> generatedGames() {
+	vector<BenchGame> games;
+
+	// Quiet: small tiles everywhere, a move grows its neighbours but nothing pops
+	engine.newGame();
+	Board& board = engine.board();
+	for (int x = 0; x < engine.len(); x++) {
+		for (int y = 0; y < engine.height(); y++) {
+			if (board[x][y].type == Tile::TileType::BLOCKED) continue;
+			board[x][y].type = (Tile::TileType)((x + 2 * y) % 5);
+			board[x][y].size = 0;
+		}
+	}
+	for (int y = 1; y <= 3; y++) {
+		board[4][y].type = Tile::TileType::red;
+	}
+	games.push_back(captureGame("generated-quiet", 3));
+
+	// Cascade: one color, every tile about to pop, so a move clears the board
+	fillCascade();
+	games.push_back(captureGame("generated-cascade", 3));
+
+	// Longest move the board allows, for parsing
+	games.push_back(captureGame("generated-longmove", engine.len() * engine.height() - 4));
+
+	// The same cascade on a bigger board with its own kernel, and on one that
+	// takes the generic kernel
+	int sizes[2][2] = { { 16, 10 }, { 13, 7 } };
+	for (int i = 0; i < 2; i++) {
+		engine.newGame(sizes[i][0], sizes[i][1]);
+		fillCascade();
+		games.push_back(captureGame("generated-cascade-" + to_string(sizes[i][0]) + "x" + to_string(sizes[i][1]), 3));
+	}
+
+	return games;
+}
+
+// Checks run by --verify instead of the benchmarks. Each prints what it
+// found wrong and returns how many checks failed.
+
+// Board the brute force search plays on, and the best move it has found
+GameSnapshot bruteStart;
+long bruteBest;
+
+// Score every path of the same color that starts with path, playing each one
+// of GROUP_MIN_TILES or more on engine from bruteStart
+void brutePaths(const Board& board, Move& path, vector<vector<bool>>& used) {
+	if (path.size() >= GROUP_MIN_TILES) {
+		bruteBest = max(bruteBest, engine.applyMove(path).scoreDelta);
+		engine.restore(bruteStart);
+	}
+	JGraph::Point<int> last = path.back();
+	for (int dx = -1; dx <= 1; dx++) {
+		for (int dy = -1; dy <= 1; dy++) {
+			int x = last.x + dx;
+			int y = last.y + dy;
+			if (x < 0 || x >= board.size() || y < 0 || y >= board[0].size()) continue;
+			if (used[x][y] || board[x][y].type != board[last.x][last.y].type) continue;
+			used[x][y] = true;
+			path.push_back({ x, y });
+			brutePaths(board, path, used);
+			path.pop_back();
+			used[x][y] = false;
+		}
+	}
+}
+
+// LastTurnOracle against trying every path, on small random boards under
+// every rule set and on boards of two colors, where the pruning does the most
+int verifyOracle() {
+	int failures = 0;
+	int boards = 0;
+	for (int k = 0; k < 600; k++) {
+		int len = 3 + k % 3;
+		int height = 3 + (k / 3) % 3;
+		engine.seed(k);
+		engine.setRules((RuleSet)(k % (int)RuleSet::COUNT));
+		engine.newGame(len, height);
+		if (k >= 300) {
+			minstd_rand colors(k);
+			Board& tiles = engine.board();
+			for (int x = 0; x < len; x++) {
+				for (int y = 0; y < height; y++) {
+					if (tiles[x][y].type != Tile::TileType::BLOCKED) tiles[x][y].type = (Tile::TileType)(colors() % 2);
+				}
+			}
+		}
+
+		LastTurnOracle oracle;
+		ExactMove best = oracle.best(engine);
+		long oracleScore = best.moves.empty() ? -1 : best.score;
+
+		bruteStart = engine.snapshot();
+		bruteBest = -1;
+		Board board = ((const GameEngine&)engine).board();
+		for (int x = 0; x < len; x++) {
+			for (int y = 0; y < height; y++) {
+				if (board[x][y].type == Tile::TileType::BLOCKED) continue;
+				Move path = { { x, y } };
+				vector<vector<bool>> used(len, vector<bool>(height, false));
+				used[x][y] = true;
+				brutePaths(board, path, used);
+			}
+		}
+
+		Move parsed;
+		int badMove;
+		if (!best.moves.empty() && engine.validateMove(moveText(best.moves), parsed, badMove) != 0) {
+			cout << "LastTurnOracle::best: board " << k << " gave an invalid move " << moveText(best.moves) << endl;
+			failures++;
+		}
+		if (oracleScore != bruteBest) {
+			cout << "LastTurnOracle::best: board " << k << " scored " << oracleScore << ", every path finds " << bruteBest << endl;
+			failures++;
+		}
+		boards++;
+	}
+	cerr << "LastTurnOracle::best: " << boards << " boards checked, " << failures << " failed" << endl;
+	engine.setRules(RuleSet::classic);
+	return failures;
+}
+
+// The groups kept up to date move by move against building them again, over
+// random seeded games of several sizes and every rule set
+int verifyGroups() {
+	int failures = 0;
+	int moves = 0;
+	int sizes[4][2] = { { BOARD_LEN, BOARD_HEIGHT }, { 16, 10 }, { 13, 7 }, { 40, 25 } };
+	for (int k = 0; k < 200; k++) {
+		engine.seed(k);
+		engine.setRules((RuleSet)(k % (int)RuleSet::COUNT));
+		engine.newGame(sizes[k % 4][0], sizes[k % 4][1]);
+		minstd_rand choices(k);
+		while (engine.turns() > 0 && failures < 10) {
+			vector<Move> candidates;
+			candidateMoves(((const GameEngine&)engine).board(), candidates);
+			if (candidates.empty()) break;
+			engine.applyMove(candidates[choices() % candidates.size()]);
+			moves++;
+
+			const GroupIndex& kept = engine.groups();
+			GroupIndex fresh;
+			fresh.build(((const GameEngine&)engine).board());
+			bool same = kept.playable() == fresh.playable() && kept.largest() == fresh.largest();
+			unordered_map<int, int> freshToKept;
+			for (int x = 0; x < engine.len() && same; x++) {
+				for (int y = 0; y < engine.height() && same; y++) {
+					same = kept.groupSize(x, y) == fresh.groupSize(x, y);
+					if (!same || fresh.groupOf(x, y) < 0) continue;
+					// The groups can be numbered differently but must hold the same tiles
+					auto found = freshToKept.emplace(fresh.groupOf(x, y), kept.groupOf(x, y));
+					same = found.first->second == kept.groupOf(x, y);
+				}
+			}
+			if (!same) {
+				cout << "GameEngine::groups: game " << k << " differs from GroupIndex::build after move " << moves << endl;
+				failures++;
+			}
+		}
+	}
+	cerr << "GameEngine::groups: " << moves << " moves checked, " << failures << " failed" << endl;
+	engine.setRules(RuleSet::classic);
+	return failures;
+}
+
+void writeJSON(ostream& out) {
+	out << "{\n  \"benchmarks\": [\n";
+	for (int i = 0; i < results.size(); i++) {
+		BenchResult& r = results[i];
+		out << "    {\"name\": \"" << r.name << "\", \"input\": \"" << r.input << "\""
+			<< ", \"iterations\": " << r.iterations
+			<< ", \"ns_per_op\": " << r.mean_ns
+			<< ", \"p50_ns\": " << r.p50_ns
+			<< ", \"p90_ns\": " << r.p90_ns
+			<< ", \"p99_ns\": " << r.p99_ns
+			<< ", \"max_ns\": " << r.max_ns
+			<< ", \"allocs_per_op\": " << r.allocs_per_op
+			<< ", \"bytes_per_op\": " << r.bytes_per_op;
+		if (!r.counters.empty()) out << ", \"counters\": " << r.counters;
+		out << "}" << ((i + 1 < results.size()) ? ",\n" : "\n");
+	}
+	out << "  ]\n}\n";
+}
+
+int main(int argc, char* argv[]) {
+	string savesDir = "saveStates";
+	string outName;
+	bool render = false;
+	bool verify = false;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--filter" && i + 1 < argc) benchFilter = argv[++i];
+		else if (arg == "--min-time" && i + 1 < argc) minTimeMs = atof(argv[++i]);
+		else if (arg == "--saves" && i + 1 < argc) savesDir = argv[++i];
+		else if (arg == "--render") render = true;
+		else if (arg == "--perf") {
+			if (!perf().start()) cerr << "Hardware counters unavailable (" << perf().error << "), continuing without them." << endl;
+		}
+		else if (arg == "--out" && i + 1 < argc) outName = argv[++i];
+		else if (arg == "--verify") verify = true;
+		else {
+			cout << "Usage: ./puzzle_bench [--filter text] [--min-time ms] [--saves dir] [--render] [--perf] [--out file] [--verify]" << endl;
+			return -1;
+		}
+	}
+
+	if (verify) {
+		int failures = verifyOracle() + verifyGroups();
+		return failures ? 1 : 0;
+	}
+
+	// Same refills every run
+	engine.seed(1);
+	allocTracking = true;
+	calibrateClock();
+
+	vector<BenchGame> games = loadSaves(savesDir);
+	vector<BenchGame> generated = generatedGames();
+	games.insert(games.end(), generated.begin(), generated.end());
+
+	for (int g = 0; g < games.size(); g++) {
+		BenchGame& game = games[g];
+		if (game.move.empty()) continue;
+
+		// Engine
+		string kind = "gameProcedure";
+		if (game.name == "generated-quiet") kind += "/quiet";
+		else if (game.name.find("generated") == 0) kind += "/cascade";
+		bench(kind, game.name, [&]() { loadGame(game); }, [&]() { engine.applyMove(game.move); });
+
+		bench("moveParse", game.name, [&]() { loadGame(game); }, [&]() {
+			vector<JGraph::Point<int>> moves;
+			int badMove;
+			engine.validateMove(game.moveText, moves, badMove);
+		});
+	}
+
+	// Gravity with the whole board popped, the most tileFall ever has to move
+	BenchGame& cascade = *find_if(games.begin(), games.end(), [](const BenchGame& game) { return game.name == "generated-cascade"; });
+	vector<int> everyColumn(cascade.state.len(), cascade.state.height() - 1);
+	bench("tileFall", "all-empty", [&]() {
+		loadGame(cascade);
+		Board& board = engine.board();
+		for (int x = 0; x < engine.len(); x++) {
+			for (int y = 0; y < engine.height(); y++) {
+				if (board[x][y].type != Tile::TileType::BLOCKED) board[x][y].type = Tile::TileType::empty;
+			}
+		}
+	}, [&]() { engine.tileFall(everyColumn); });
+
+	// A 1024x1024 board: a move, and catching the drawn points up with it,
+	// should cost about what they do on a small board
+	engine.newGame(1024, 1024);
+	BenchGame large = captureGame("generated-1024x1024", 3);
+	BoardPoints points;
+	bench("gameProcedure/large", large.name, [&]() { loadGame(large); }, [&]() { engine.applyMove(large.move); });
+	bench("BoardPoints::update", large.name + "/after-move", [&]() {
+		loadGame(large);
+		points.update(engine.board());
+		engine.applyMove(large.move);
+	}, [&]() { points.update(engine.board()); });
+	bench("BoardPoints::update", large.name + "/whole-board", [&]() { loadGame(large); }, [&]() { points.update(engine.board()); });
+
+	// Snapshots before and after a move share every chunk the move didn't
+	// touch, so taking one or going back to one should cost about the move
+	BenchGame* snapshotGames[] = { &cascade, &large };
+	GameSnapshot before, taken;
+	for (int g = 0; g < 2; g++) {
+		BenchGame& game = *snapshotGames[g];
+		bench("GameEngine::snapshot", game.name + "/unchanged", [&]() {
+			taken = GameSnapshot();
+			loadGame(game);
+			before = engine.snapshot();
+		}, [&]() { taken = engine.snapshot(); });
+		bench("GameEngine::snapshot", game.name + "/after-move", [&]() {
+			taken = GameSnapshot();
+			loadGame(game);
+			before = engine.snapshot();
+			engine.applyMove(game.move);
+		}, [&]() { taken = engine.snapshot(); });
+		bench("GameEngine::restore", game.name + "/undo-move", [&]() {
+			loadGame(game);
+			before = engine.snapshot();
+			engine.applyMove(game.move);
+		}, [&]() { engine.restore(before); });
+	}
+
+	// Each rule set plays the same move through its own instantiation of the
+	// cascade, so a variant should cost about what classic does for the tiles
+	// it pops
+	for (int r = 0; r < (int)RuleSet::COUNT; r++) {
+		RuleSet rules = (RuleSet)r;
+		for (int g = 0; g < 2; g++) {
+			BenchGame& game = *snapshotGames[g];
+			bench(string("gameProcedure/") + ruleSetName(rules), game.name, [&]() {
+				loadGame(game);
+				engine.setRules(rules);
+			}, [&]() { engine.applyMove(game.move); });
+		}
+	}
+
+	// Groups from scratch, and caught up after a move, which should only cost
+	// the groups around the columns that fell
+	for (int g = 0; g < 2; g++) {
+		BenchGame& game = *snapshotGames[g];
+		GroupIndex groups;
+		bench("GroupIndex::build", game.name, [&]() { loadGame(game); }, [&]() { groups.build(engine.board()); });
+		bench("GameEngine::groups", game.name + "/after-move", [&]() {
+			loadGame(game);
+			engine.groups();
+			engine.applyMove(game.move);
+		}, [&]() { engine.groups(); });
+	}
+
+	// A hint should answer within its budget however big the board is
+	for (int g = 0; g < 2; g++) {
+		BenchGame& game = *snapshotGames[g];
+		bench("findHint/20ms", game.name, [&]() { loadGame(game); }, [&]() { findHint(engine, 20); });
+	}
+
+	// The exact last-turn move, worked out from nothing on every board, and
+	// once remembered on the board of one color
+	LastTurnOracle oracle;
+	for (int g = 0; g < games.size(); g++) {
+		BenchGame& game = games[g];
+		bench("LastTurnOracle::best", game.name, [&]() {
+			loadGame(game);
+			oracle.clear();
+		}, [&]() { oracle.best(engine); });
+	}
+	for (int g = 0; g < games.size(); g++) {
+		if (games[g].name != "green.txt") continue;
+		bench("LastTurnOracle::best", games[g].name + "/remembered", [&]() { loadGame(games[g]); }, [&]() { oracle.best(engine); });
+	}
+
+	// Save files
+	string tempSave = "/tmp/puzzle_bench_save.txt";
+	for (int g = 0; g < games.size(); g++) {
+		BenchGame& game = games[g];
+		string saveName = savesDir + "/" + game.name;
+		if (game.name.find("generated") != 0) {
+			bench("gameRead", game.name, []() {}, [&]() { engine.load(saveName); });
+		}
+		bench("gameSave", game.name, [&]() { loadGame(game); }, [&]() { engine.save(tempSave); });
+	}
+	remove(tempSave.c_str());
+
+	// Drawing
+	for (int g = 0; g < games.size(); g++) {
+		BenchGame& game = games[g];
+		bench("drawBoard/canvas", game.name, []() {}, [&]() {
+			JGraph::Canvas canvas = boardCanvas(game.state.board(), game.state.score(), game.state.turns());
+		});
+		JGraph::Arena arena(64 * 1024);
+		bench("drawBoard/canvas-arena", game.name, []() {}, [&]() {
+			{
+				JGraph::Canvas canvas = boardCanvas(game.state.board(), game.state.score(), game.state.turns(), arena.get());
+			}
+			arena.reset();
+		});
+
+		JGraph::Canvas canvas = boardCanvas(game.state.board(), game.state.score(), game.state.turns());
+		bench("Canvas::toJGraph", game.name, []() {}, [&]() {
+			ostringstream script;
+			PerfScope counters(PerfKernel::serialize);
+			canvas.toJGraph(script);
+		});
+
+		if (render) {
+			bench("jgraphToJPG", game.name, []() {}, [&]() {
+				JGraph::jgraphToJPG(canvas, "/tmp/puzzle_bench.jpg");
+			});
+		}
+	}
+
+	// A long simulation trace, written in full and thinned to the x axis
+	JGraph::Canvas plot;
+	plot.graphs.emplace_back();
+	plot.graphs[0].xaxis.size_inches = 6;
+	plot.graphs[0].curves.emplace_back();
+	JGraph::Curve& trace = plot.graphs[0].curves[0];
+	trace.makeMark<JGraph::ShapeMark>()->type = JGraph::ShapeMark::Type::none;
+	for (int i = 0; i < 200000; i++) {
+		trace.points.push_back({ (float)i, (float)(sin(i * 0.001) * 100 + (i * 7919) % 37) });
+	}
+	const char* decimations[] = { "none", "minMax", "lttb" };
+	for (int d = 0; d < 3; d++) {
+		trace.decimation = (JGraph::Curve::Decimation)d;
+		string input = string("200k-points/") + decimations[d];
+		bench("Curve::toJGraph", input, []() {}, [&]() {
+			ostringstream script;
+			PerfScope counters(PerfKernel::serialize);
+			plot.toJGraph(script);
+		});
+		if (render) {
+			bench("jgraphToJPG", input, []() {}, [&]() {
+				JGraph::jgraphToJPG(plot, "/tmp/puzzle_bench.jpg");
+			});
+		}
+	}
+
+	// The same trace read from separate score and turn arrays in place
+	vector<float> turns(trace.points.size());
+	vector<float> scores(trace.points.size());
+	for (int i = 0; i < trace.points.size(); i++) {
+		turns[i] = trace.points[i].x;
+		scores[i] = trace.points[i].y;
+	}
+	trace.points.clear();
+	trace.pointSource = JGraph::PointSource(turns.data(), scores.data(), turns.size());
+	trace.decimation = JGraph::Curve::Decimation::minMax;
+	bench("Curve::toJGraph", "200k-points/strided-minMax", []() {}, [&]() {
+		ostringstream script;
+		PerfScope counters(PerfKernel::serialize);
+		plot.toJGraph(script);
+	});
+	if (render) remove("/tmp/puzzle_bench.jpg");
+
+	// A page of stat panels, on one thread and on every core
+	JGraph::Canvas dashboard;
+	for (int g = 0; g < 24; g++) {
+		dashboard.graphs.emplace_back();
+		dashboard.graphs.back().curves.emplace_back();
+		JGraph::Curve& panel = dashboard.graphs.back().curves.back();
+		for (int i = 0; i < 20000; i++) {
+			panel.points.push_back({ (float)i, (float)((i * 31 + g) % 101) });
+		}
+	}
+	unsigned cores = max(1u, thread::hardware_concurrency());
+	vector<unsigned> threadCounts = { 1 };
+	for (unsigned threads = 2; threads < cores; threads *= 2) threadCounts.push_back(threads);
+	if (cores > 1) threadCounts.push_back(cores);
+	for (int t = 0; t < threadCounts.size(); t++) {
+		dashboard.serialize_threads = threadCounts[t];
+		bench("Canvas::toJGraph", "dashboard-24/threads-" + to_string(threadCounts[t]), []() {}, [&]() {
+			ostringstream script;
+			dashboard.toJGraph(script);
+		});
+	}
+
+	if (outName.empty()) {
+		writeJSON(cout);
+	}
+	else {
+		ofstream out(outName);
+		writeJSON(out);
+	}
+
+	return 0;
+}
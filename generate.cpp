@@ -0,0 +1,357 @@
+/*
+-----------------------------
+Puzzle generator for the Puzzle Game
+-----------------------------
+
+Deals boards until enough of them meet the constraints asked for and writes
+them as save files, ready to play with ./puzzle -s. Boards are dealt and
+scored on every core at once, without drawing anything.
+
+Build and run with make generate, or by calling:
+
+./puzzle_generate outDir [--count N] [--difficulty easy|medium|hard] [--size WxH] [--rules name] [--moves MIN-MAX]
+	[--score MIN-MAX] [--waves MIN-MAX] [--colors r,g,b,p,y] [--seed N] [-j workers]
+
+--count N --- Boards to write, as outDir/board0000.txt and on (default 100)
+--difficulty level --- Pick the opening moves and score ranges for easy, medium or hard boards
+--size WxH --- Board size (default 9x6)
+--rules name --- Rule set the boards are dealt, scored and saved with (default classic, see Rules.h)
+--moves MIN-MAX --- Groups of 3 or more tiles the first move can be made in
+--score MIN-MAX --- Points of the best first move there is, worked out exactly
+--waves MIN-MAX --- Cascade waves the best first move sets off
+--colors r,g,b,p,y --- Shares of red, green, blue, purple and yellow tiles (default 1,1,1,1,1)
+--seed N --- Seed for the boards dealt, the same seed gives the same boards (default 1)
+-j workers --- Threads to deal and score boards on (default: all cores)
+
+Either end of a range can be left open (5- or -5), and a single number asks
+for exactly that. Every board gets the shares of colors given, to the
+nearest tile, with random sizes.
+
+A difficulty is picked from boards dealt the same way: the best first move of
+an easy board is worth more than two thirds of them, a medium board's is in
+the middle third and a hard board's in the bottom third. Easy boards also
+have at least the median number of opening moves, and hard ones at most.
+--moves or --score given as well replace the difficulty's range.
+
+Only the first move is scored, as the tiles dealt after it aren't part of a
+save. The boards written are the first that meet the constraints in the
+order they are dealt, so they don't depend on the number of threads.
+*/
+
+#include "GameEngine.h"
+#include "Search.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <climits>
+#include <cstdlib>
+#include <cerrno>
+#include <sys/stat.h>
+
+using namespace std;
+
+// Boards dealt to pick the ranges of a difficulty
+#define CALIBRATION_BOARDS 600
+
+// Boards dealt for each one asked for before giving up
+#define GIVE_UP_RATIO 10000
+
+#define COLOR_COUNT 5
+
+// Values from low to high, either end open
+struct Range {
+	long low;
+	long high;
+
+	Range() {
+		low = LONG_MIN;
+		high = LONG_MAX;
+	}
+
+	bool has(long value) const {
+		return value >= low && value <= high;
+	}
+
+	string text() const {
+		if (low == LONG_MIN && high == LONG_MAX) return "any";
+		if (low == LONG_MIN) return "at most " + to_string(high);
+		if (high == LONG_MAX) return "at least " + to_string(low);
+		if (low == high) return to_string(low);
+		return to_string(low) + "-" + to_string(high);
+	}
+};
+
+// Parse MIN-MAX, MIN-, -MAX or N, false if text is none of them
+bool parseRange(string text, Range& range) {
+	size_t dash = text.find('-');
+	string low = text.substr(0, dash);
+	string high = (dash == string::npos) ? low : text.substr(dash + 1);
+	if (low.empty() && high.empty()) return false;
+	if (low.find_first_not_of("0123456789") != string::npos || high.find_first_not_of("0123456789") != string::npos) return false;
+	range = Range();
+	if (!low.empty()) range.low = atol(low.c_str());
+	if (!high.empty()) range.high = atol(high.c_str());
+	return range.low <= range.high;
+}
+
+// What a board asks of its first move
+struct Rating {
+	int moves; // Groups the first move can be made in
+	long score; // Points of the best first move, 0 if there is none
+	int waves; // Cascade waves that move sets off
+};
+
+struct Settings {
+	int len;
+	int height;
+	RuleSet rules;
+	unsigned long seed;
+	int colorShare[COLOR_COUNT];
+	Range moves;
+	Range score;
+	Range waves;
+
+	bool accepts(const Rating& rating) const {
+		return moves.has(rating.moves) && score.has(rating.score) && waves.has(rating.waves);
+	}
+};
+
+// Deal board number index: the shares of colors asked for, shuffled, with
+// random sizes. The same settings and index always deal the same board.
+void deal(GameEngine& game, const Settings& settings, long index) {
+	seed_seq sequence = { settings.seed, (unsigned long)index };
+	minstd_rand rng(sequence);
+	game.seed(rng());
+	game.setRules(settings.rules);
+	game.newGame(settings.len, settings.height);
+
+	Board& board = game.board();
+	int open = 0;
+	for (int x = 0; x < game.len(); x++) {
+		for (int y = 0; y < game.height(); y++) {
+			if (board[x][y].type != Tile::TileType::BLOCKED) open++;
+		}
+	}
+	int popSize = withRules(settings.rules, [](auto rules) { return decltype(rules)::popSize; });
+	int shares = 0;
+	for (int c = 0; c < COLOR_COUNT; c++) {
+		shares += settings.colorShare[c];
+	}
+	vector<Tile::TileType> colors;
+	colors.reserve(open);
+	int shareSoFar = 0;
+	for (int c = 0; c < COLOR_COUNT; c++) {
+		int first = (int)((long)open * shareSoFar / shares);
+		shareSoFar += settings.colorShare[c];
+		int last = (int)((long)open * shareSoFar / shares);
+		colors.insert(colors.end(), last - first, (Tile::TileType)c);
+	}
+	shuffle(colors.begin(), colors.end(), rng);
+
+	int next = 0;
+	for (int x = 0; x < game.len(); x++) {
+		for (int y = 0; y < game.height(); y++) {
+			if (board[x][y].type == Tile::TileType::BLOCKED) continue;
+			board[x][y].type = colors[next++];
+			board[x][y].size = min<int>(rng() % 3, popSize - 1);
+		}
+	}
+}
+
+// Rate the first move of game without changing it
+Rating rate(GameEngine& game, LastTurnOracle& oracle) {
+	Rating rating;
+	rating.moves = game.groups().playable();
+	rating.score = 0;
+	rating.waves = 0;
+
+	// Every board is new, so nothing the oracle remembers would be asked again
+	oracle.clear();
+	ExactMove best = oracle.best(game);
+	if (!best.moves.empty()) {
+		rating.score = best.score;
+		GameSnapshot before = game.snapshot();
+		rating.waves = game.applyMove(best.moves).waves;
+		game.restore(before);
+	}
+	return rating;
+}
+
+// Deal and rate boards first to last - 1 on workers threads, calling found
+// with the index and rating of each one (under a lock) until it returns false
+void dealBoards(const Settings& settings, long first, long last, unsigned workers,
+	const function<bool(long, const Rating&)>& found) {
+	atomic<long> next(first);
+	atomic<bool> stop(false);
+	mutex foundLock;
+	vector<thread> pool;
+	for (unsigned w = 0; w < workers; w++) {
+		pool.push_back(thread([&]() {
+			GameEngine game;
+			LastTurnOracle oracle;
+			while (!stop) {
+				long index = next++;
+				if (index >= last) return;
+				deal(game, settings, index);
+				Rating rating = rate(game, oracle);
+				lock_guard<mutex> guard(foundLock);
+				if (!found(index, rating)) stop = true;
+			}
+		}));
+	}
+	for (int i = 0; i < pool.size(); i++) {
+		pool[i].join();
+	}
+}
+
+// Value a fraction of the way through sorted values
+long quantile(const vector<long>& values, double fraction) {
+	return values[min((size_t)(fraction * values.size()), values.size() - 1)];
+}
+
+// Set the ranges of difficulty that weren't given, from boards dealt the same
+// way. false if difficulty isn't one.
+bool calibrate(Settings& settings, string difficulty, bool movesGiven, bool scoreGiven, unsigned workers) {
+	if (difficulty != "easy" && difficulty != "medium" && difficulty != "hard") return false;
+
+	// Boards numbered below 0, so none of them are written
+	vector<long> scores, moves;
+	dealBoards(settings, -CALIBRATION_BOARDS, 0, workers, [&](long index, const Rating& rating) {
+		scores.push_back(rating.score);
+		moves.push_back(rating.moves);
+		return true;
+	});
+	sort(scores.begin(), scores.end());
+	sort(moves.begin(), moves.end());
+
+	Range score, opening;
+	if (difficulty == "easy") {
+		score.low = quantile(scores, 2.0 / 3) + 1;
+		opening.low = quantile(moves, 0.5);
+	}
+	else if (difficulty == "medium") {
+		score.low = quantile(scores, 1.0 / 3) + 1;
+		score.high = quantile(scores, 2.0 / 3);
+	}
+	else {
+		score.high = quantile(scores, 1.0 / 3);
+		opening.high = quantile(moves, 0.5);
+	}
+	if (!scoreGiven) settings.score = score;
+	if (!movesGiven) settings.moves = opening;
+	return true;
+}
+
+void usage() {
+	cout << "Usage: ./puzzle_generate outDir [--count N] [--difficulty easy|medium|hard] [--size WxH] [--rules name] [--moves MIN-MAX]" << endl
+		<< "\t[--score MIN-MAX] [--waves MIN-MAX] [--colors r,g,b,p,y] [--seed N] [-j workers]" << endl;
+}
+
+int main(int argc, char* argv[]) {
+	string outDir;
+	string difficulty;
+	long count = 100;
+	bool movesGiven = false;
+	bool scoreGiven = false;
+	unsigned workers = thread::hardware_concurrency();
+	Settings settings;
+	settings.len = BOARD_LEN;
+	settings.height = BOARD_HEIGHT;
+	settings.rules = RuleSet::classic;
+	settings.seed = 1;
+	for (int c = 0; c < COLOR_COUNT; c++) {
+		settings.colorShare[c] = 1;
+	}
+
+	bool valid = true;
+	for (int i = 1; i < argc && valid; i++) {
+		string arg = argv[i];
+		if (arg == "--count" && i + 1 < argc) {
+			count = atol(argv[++i]);
+			valid = count > 0;
+		}
+		else if (arg == "--difficulty" && i + 1 < argc) difficulty = argv[++i];
+		else if (arg == "--size" && i + 1 < argc) valid = parseBoardSize(argv[++i], settings.len, settings.height);
+		else if (arg == "--rules" && i + 1 < argc) valid = parseRuleSet(argv[++i], settings.rules);
+		else if (arg == "--moves" && i + 1 < argc) valid = movesGiven = parseRange(argv[++i], settings.moves);
+		else if (arg == "--score" && i + 1 < argc) valid = scoreGiven = parseRange(argv[++i], settings.score);
+		else if (arg == "--waves" && i + 1 < argc) valid = parseRange(argv[++i], settings.waves);
+		else if (arg == "--colors" && i + 1 < argc) {
+			istringstream shares(argv[++i]);
+			int total = 0;
+			char comma = ',';
+			for (int c = 0; c < COLOR_COUNT && valid; c++) {
+				valid = comma == ',' && (shares >> settings.colorShare[c]) && settings.colorShare[c] >= 0;
+				if (valid) total += settings.colorShare[c];
+				comma = 0;
+				shares >> comma;
+			}
+			valid = valid && total > 0 && shares.eof();
+		}
+		else if (arg == "--seed" && i + 1 < argc) settings.seed = strtoul(argv[++i], NULL, 10);
+		else if (arg == "-j" && i + 1 < argc) workers = atoi(argv[++i]);
+		else if (outDir.empty() && arg[0] != '-') outDir = arg;
+		else valid = false;
+	}
+	if (!valid || outDir.empty()) {
+		usage();
+		return -1;
+	}
+	if (workers == 0) workers = 1;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	if (!difficulty.empty() && !calibrate(settings, difficulty, movesGiven, scoreGiven, workers)) {
+		usage();
+		return -1;
+	}
+	cout << settings.len << "x" << settings.height << " " << ruleSetName(settings.rules) << " boards with " << settings.moves.text() << " opening moves, "
+		<< settings.score.text() << " points for the best first move and " << settings.waves.text() << " cascade waves" << endl;
+
+	if (mkdir(outDir.c_str(), 0755) != 0 && errno != EEXIST) {
+		cout << "Unable to make " << outDir << "." << endl;
+		return 1;
+	}
+
+	// Keep every board that meets the constraints until there are enough.
+	// Every board before the last one dealt has been rated by the time the
+	// threads stop, so the first count of them are the same every run.
+	vector<long> accepted;
+	long dealt = 0;
+	dealBoards(settings, 0, count * GIVE_UP_RATIO, workers, [&](long index, const Rating& rating) {
+		dealt++;
+		if (settings.accepts(rating)) accepted.push_back(index);
+		return (long)accepted.size() < count;
+	});
+	sort(accepted.begin(), accepted.end());
+	if ((long)accepted.size() > count) accepted.resize(count);
+
+	int digits = max(4, (int)to_string(count - 1).size());
+	GameEngine game;
+	for (int i = 0; i < accepted.size(); i++) {
+		ostringstream name;
+		name << outDir << "/board" << setfill('0') << setw(digits) << i << ".txt";
+		deal(game, settings, accepted[i]);
+		if (game.save(name.str()) != 0) {
+			cout << "Unable to save " << name.str() << "." << endl;
+			return 1;
+		}
+	}
+
+	double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cout << "Wrote " << accepted.size() << " boards to " << outDir << " in " << fixed << setprecision(1) << elapsed << " s ("
+		<< dealt << " dealt on " << workers << ((workers == 1) ? " thread, " : " threads, ") << dealt / elapsed << " boards/s)" << endl;
+	if ((long)accepted.size() < count) {
+		cout << "Only " << accepted.size() << " of " << dealt << " boards met the constraints, giving up." << endl;
+		return 1;
+	}
+	return 0;
+}
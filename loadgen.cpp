@@ -0,0 +1,269 @@
+/*
+-----------------------------
+Load generator for the Puzzle Game server
+-----------------------------
+
+Plays many games at once against ./puzzle --serve and reports the moves
+per second the server sustained and the latency of each move.
+
+Build and run with make loadgen, or by calling:
+
+./puzzle_loadgen socketPath [--clients N] [--seconds S] [--show N] [--jpg]
+
+--clients N --- Sessions to play at once, each on its own thread (default 8)
+--seconds S --- How long to play for (default 10)
+--show N --- Also ask for a frame every N moves of a session (needs jgraph and convert)
+--jpg --- Have frames sent back as bytes instead of file paths
+
+Each session asks for the board, plays the first straight line of three
+tiles of one color it finds from a random starting point, and starts a new
+game when it runs out of turns. Only the moves and frames are timed.
+*/
+
+#include "Stats.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+
+// One connection to the server, answering line by line
+class Client {
+public:
+	Client() {
+		fd = -1;
+	}
+	~Client() {
+		if (fd >= 0) close(fd);
+	}
+
+	bool connectTo(string path) {
+		sockaddr_un address;
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(address.sun_path)) return false;
+		strcpy(address.sun_path, path.c_str());
+		fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		return fd >= 0 && connect(fd, (sockaddr*)&address, sizeof(address)) == 0;
+	}
+
+	// Send a command and read the line that answers it, false if the server went away
+	bool ask(const string& command, string& answer) {
+		string line = command + "\n";
+		for (size_t sent = 0; sent < line.size();) {
+			ssize_t length = send(fd, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+			if (length <= 0) return false;
+			sent += length;
+		}
+		return readLine(answer);
+	}
+
+	bool readLine(string& line) {
+		while (true) {
+			size_t end = buffer.find('\n');
+			if (end != string::npos) {
+				line = buffer.substr(0, end);
+				buffer.erase(0, end + 1);
+				return true;
+			}
+			if (!fill()) return false;
+		}
+	}
+
+	// Skip length bytes, the image after a jpg answer
+	bool skip(size_t length) {
+		while (buffer.size() < length) {
+			if (!fill()) return false;
+		}
+		buffer.erase(0, length);
+		return true;
+	}
+
+private:
+	bool fill() {
+		char chunk[64 * 1024];
+		ssize_t length = recv(fd, chunk, sizeof(chunk), 0);
+		if (length <= 0) return false;
+		buffer.append(chunk, length);
+		return true;
+	}
+
+	int fd;
+	string buffer;
+};
+
+// First straight line of three tiles of one color from a random cell, as a
+// move, or empty if there isn't one. board is the answer to "board".
+string findMove(const string& board, minstd_rand& rng) {
+	istringstream words(board);
+	string word, size, columns;
+	long score;
+	int turns;
+	words >> word >> size >> score >> turns >> columns;
+	int len = atoi(size.c_str());
+	int height = atoi(size.substr(size.find('x') + 1).c_str());
+	if (len <= 0 || height <= 0 || (int)columns.size() != len * (height + 1) - 1) return "";
+
+	// Color of a tile, -1 for blocked or empty
+	auto color = [&](int x, int y) {
+		char c = columns[x * (height + 1) + y];
+		int value = (c <= '9') ? c - '0' : c - 'a' + 10;
+		return (value < 15) ? value / 3 : -1;
+	};
+
+	int start = rng() % (len * height);
+	for (int k = 0; k < len * height; k++) {
+		int cell = (start + k) % (len * height);
+		int x = cell / height;
+		int y = cell % height;
+		int type = color(x, y);
+		if (type < 0) continue;
+		for (int d = 0; d < 2; d++) {
+			int dx = d;
+			int dy = 1 - d;
+			if (x + 2 * dx >= len || y + 2 * dy >= height) continue;
+			if (color(x + dx, y + dy) != type || color(x + 2 * dx, y + 2 * dy) != type) continue;
+			return "{(" + to_string(x) + "," + to_string(y) + "),(" + to_string(x + dx) + "," + to_string(y + dy)
+				+ "),(" + to_string(x + 2 * dx) + "," + to_string(y + 2 * dy) + ")}";
+		}
+	}
+	return "";
+}
+
+// What one session played
+struct ClientResult {
+	LatencyHistogram moves;
+	LatencyHistogram frames;
+	long games;
+	long errors;
+	bool connected;
+};
+
+void printLatency(string name, const LatencyHistogram& h) {
+	cout << left << setw(8) << name << right << setw(10) << h.count << fixed << setprecision(1)
+		<< setw(12) << h.mean() / 1000 << setw(12) << h.percentile(0.50) / 1000.0
+		<< setw(12) << h.percentile(0.95) / 1000.0 << setw(12) << h.percentile(0.99) / 1000.0
+		<< setw(12) << h.max / 1000.0 << endl;
+}
+
+int main(int argc, char* argv[]) {
+	string path;
+	int clients = 8;
+	double seconds = 10;
+	int showEvery = 0;
+	bool jpg = false;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--clients" && i + 1 < argc) clients = atoi(argv[++i]);
+		else if (arg == "--seconds" && i + 1 < argc) seconds = atof(argv[++i]);
+		else if (arg == "--show" && i + 1 < argc) showEvery = atoi(argv[++i]);
+		else if (arg == "--jpg") jpg = true;
+		else if (path.empty() && arg[0] != '-') path = arg;
+		else {
+			path.clear();
+			break;
+		}
+	}
+	if (path.empty() || clients <= 0 || seconds <= 0) {
+		cout << "Usage: ./puzzle_loadgen socketPath [--clients N] [--seconds S] [--show N] [--jpg]" << endl;
+		return -1;
+	}
+
+	vector<ClientResult> results(clients);
+	atomic<bool> stop(false);
+	vector<thread> pool;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (int c = 0; c < clients; c++) {
+		pool.push_back(thread([&, c]() {
+			ClientResult& result = results[c];
+			result.games = 1;
+			result.errors = 0;
+			Client client;
+			result.connected = client.connectTo(path);
+			if (!result.connected) return;
+
+			minstd_rand rng(c + 1);
+			string board, answer;
+			long played = 0;
+			while (!stop) {
+				if (!client.ask("board", board)) return;
+				string move = findMove(board, rng);
+				if (move.empty()) {
+					if (!client.ask("new", answer)) return;
+					result.games++;
+					continue;
+				}
+
+				chrono::steady_clock::time_point sent = chrono::steady_clock::now();
+				if (!client.ask(move, answer)) return;
+				result.moves.record(nanosSince(sent));
+				played++;
+
+				// ok <points> <score> <turns> <popped> <waves>
+				istringstream words(answer);
+				string word;
+				long points, score;
+				int turns = -1;
+				words >> word >> points >> score >> turns;
+				if (word != "ok") result.errors++;
+
+				if (showEvery > 0 && played % showEvery == 0) {
+					sent = chrono::steady_clock::now();
+					if (!client.ask(jpg ? "show jpg" : "show", answer)) return;
+					if (answer.compare(0, 4, "jpg ") == 0 && !client.skip(strtoul(answer.c_str() + 4, NULL, 10))) return;
+					if (answer.compare(0, 6, "error ") == 0) result.errors++;
+					else result.frames.record(nanosSince(sent));
+				}
+
+				if (turns == 0) {
+					if (!client.ask("new", answer)) return;
+					result.games++;
+				}
+			}
+			client.ask("quit", answer);
+		}));
+	}
+
+	this_thread::sleep_for(chrono::duration<double>(seconds));
+	stop = true;
+	for (int i = 0; i < pool.size(); i++) {
+		pool[i].join();
+	}
+	double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	ClientResult total;
+	total.games = 0;
+	total.errors = 0;
+	int connected = 0;
+	for (int c = 0; c < clients; c++) {
+		if (!results[c].connected) continue;
+		connected++;
+		total.moves.add(results[c].moves);
+		total.frames.add(results[c].frames);
+		total.games += results[c].games;
+		total.errors += results[c].errors;
+	}
+	if (connected == 0) {
+		cout << "Unable to connect to " << path << "." << endl;
+		return 1;
+	}
+
+	cout << connected << " sessions, " << fixed << setprecision(1) << elapsed << " s: " << total.moves.count << " moves in "
+		<< total.games << " games, " << total.moves.count / elapsed << " moves/s, " << total.errors << " errors" << endl;
+	cout << left << setw(8) << "" << right << setw(10) << "count" << setw(12) << "mean us" << setw(12) << "p50 us"
+		<< setw(12) << "p95 us" << setw(12) << "p99 us" << setw(12) << "max us" << endl;
+	printLatency("move", total.moves);
+	if (total.frames.count) printLatency("frame", total.frames);
+	return 0;
+}